@@ -5,29 +5,44 @@
 #include <musique/errors.hh>
 #include <variant>
 #include <iostream>
+#include <musique/value/box.hh>
 #include <musique/value/collection.hh>
+#include <utility>
 
 namespace details
 {
 	template<typename T>
 	concept Reference = std::is_lvalue_reference_v<T>;
+
+	/// Whether variant holds T inside of Box
+	template<typename T, typename Variant>
+	constexpr bool holds_boxed = false;
+
+	template<typename T, typename ...V>
+	constexpr bool holds_boxed<T, std::variant<V...>> = (std::is_same_v<V, Box<T>> || ...);
 }
 
+/// Pointer to alternative Desired of variant, or nullptr when variant holds other one
+///
+/// Boxed alternatives may be shared, so they are only accessible for reading through const pointer.
+
 template<typename Desired, same_template_as<std::variant> Variant>
 requires details::Reference<Variant>
 constexpr auto get_if(Variant &&v)
 {
 	using Return_Type = std::conditional_t<
-		std::is_const_v<std::remove_reference_t<Variant>>,
+		std::is_const_v<std::remove_reference_t<Variant>> || details::holds_boxed<std::remove_const_t<Desired>, std::remove_cvref_t<Variant>>,
 		Desired const*,
 		Desired*
 	>;
 
 	return std::visit([]<details::Reference Actual>(Actual&& act) -> Return_Type {
-		if constexpr (std::is_same_v<Desired, std::remove_cvref_t<Actual>>) {
-			return &act;
-		} else if constexpr (std::is_base_of_v<Desired, std::remove_cvref_t<Actual>>) {
-			auto ret = static_cast<Return_Type>(&act);
+		using Type = Unboxed_t<Actual>;
+		if constexpr (std::is_same_v<Desired, Type>) {
+			return &unbox(act);
+		} else if constexpr (std::is_base_of_v<Desired, Type>) {
+			// Interfaces like Collection have only const members, so boxed object doesn't need to be unshared
+			auto ret = const_cast<Return_Type>(static_cast<Desired const*>(&unbox(std::as_const(act))));
 			if constexpr (std::is_same_v<std::remove_cvref_t<Desired>, Collection>) {
 				if (ret->is_collection()) {
 					return ret;
@@ -42,8 +57,17 @@ constexpr auto get_if(Variant &&v)
 	}, v);
 }
 
+/// Like std::visit, but boxed alternatives are passed to visitor as objects they hold
+template<typename Visitor, typename ...Variants>
+constexpr decltype(auto) visit_unboxed(Visitor &&visitor, Variants &&...variants)
+{
+	return std::visit([&visitor]<typename ...Actual>(Actual &&...act) -> decltype(auto) {
+		return visitor(unbox(std::forward<Actual>(act))...);
+	}, std::forward<Variants>(variants)...);
+}
+
 template<typename Desired, typename ...V>
-constexpr Desired& get_ref(std::variant<V...> &v)
+constexpr auto& get_ref(std::variant<V...> &v)
 {
 	if (auto result = get_if<Desired>(v)) { return *result; }
 	unreachable();
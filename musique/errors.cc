@@ -140,6 +140,7 @@ std::ostream& operator<<(std::ostream& os, Error const& err)
 	std::string_view short_description = visit(Overloaded {
 		[](errors::Expected_Expression_Separator_Before const&) { return "Missing semicolon"; },
 		[](errors::Failed_Numeric_Parsing const&)               { return "Failed to parse a number"; },
+		[](errors::Failed_To_Read_Midi_File const&)             { return "Cannot read MIDI file"; },
 		[](errors::Literal_As_Identifier const&)                { return "Literal used in place of an identifier"; },
 		[](errors::Missing_Variable const&)                     { return "Cannot find variable"; },
 		[](errors::Not_Callable const&)                         { return "Value not callable"; },
@@ -155,6 +156,7 @@ std::ostream& operator<<(std::ostream& os, Error const& err)
 			switch (err.type) {
 			case errors::Arithmetic::Division_By_Zero: return "Division by 0";
 			case errors::Arithmetic::Fractional_Modulo: return "Modulo with fractions";
+			case errors::Arithmetic::Overflow: return "Number too big";
 			case errors::Arithmetic::Unable_To_Calculate_Modular_Multiplicative_Inverse:
 				return "Missing modular inverse";
 			default: unreachable();
@@ -394,6 +396,15 @@ std::ostream& operator<<(std::ostream& os, Error const& err)
 			os << '\n' << pretty::end;
 		},
 
+		[&](errors::Failed_To_Read_Midi_File const& err) {
+			os << "I can't read MIDI messages from '" << err.path << "'\n";
+			os << "\n";
+			print_error_line(loc);
+
+			os << "Each line of this file should contain single message with time when it arrives, like:\n";
+			os << "  @0.500 note-on 0 60 127\n";
+		},
+
 		[&](errors::Out_Of_Range const& err) {
 			if (err.size == 0) {
 				os << "Can't get " << err.required_index << " element out of empty collection\n";
@@ -434,6 +445,13 @@ std::ostream& operator<<(std::ostream& os, Error const& err)
 				os << "  1 % (1/2)\n";
 				os << pretty::end;
 
+			break; case errors::Arithmetic::Overflow:
+				os << "Result of calculation doesn't fit in numbers that I can represent\n";
+				os << "Numerators and denominators must fit in 64 bit integers, even after reducing fraction\n";
+				os << "\n";
+
+				print_error_line(loc);
+
 			break; case errors::Arithmetic::Unable_To_Calculate_Modular_Multiplicative_Inverse:
 				os << "Tried to calculate fraction in modular space.\n";
 				os << "\n";
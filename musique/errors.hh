@@ -114,6 +114,13 @@ namespace errors
 		// put in this array
 	};
 
+	/// When file with recorded MIDI messages can't be read or parsed
+	struct Failed_To_Read_Midi_File
+	{
+		/// Path to the file that was requested
+		std::string path;
+	};
+
 	/// When user tries to invoke some MIDI action but haven't established MIDI connection
 	struct Operation_Requires_Midi_Connection
 	{
@@ -148,6 +155,7 @@ namespace errors
 		{
 			Division_By_Zero,
 			Fractional_Modulo,
+			Overflow,
 			Unable_To_Calculate_Modular_Multiplicative_Inverse
 		} type;
 	};
@@ -175,6 +183,7 @@ namespace errors
 		Closing_Token_Without_Opening,
 		Expected_Expression_Separator_Before,
 		Failed_Numeric_Parsing,
+		Failed_To_Read_Midi_File,
 		Literal_As_Identifier,
 		Missing_Variable,
 		Not_Callable,
@@ -19,7 +19,7 @@ Value_Formatter Value_Formatter::nest(Context nested) const
 
 std::optional<Error> Value_Formatter::format(std::ostream& os, Interpreter &interpreter, Value const& value)
 {
-	return std::visit(Overloaded {
+	return visit_unboxed(Overloaded {
 		[&](Intrinsic const& intrinsic) -> std::optional<Error> {
 			for (auto const& [key, val] : Env::global->variables) {
 				if (auto other = get_if<Intrinsic>(val); other && intrinsic == *other) {
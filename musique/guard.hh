@@ -35,7 +35,7 @@ struct Guard
 	}
 
 	template<typename T>
-	inline Result<T*> match(Value &v) const
+	inline Result<Access<T>*> match(Value &v) const
 	{
 		if (auto p = get_if<T>(v)) {
 			return p;
@@ -5,6 +5,7 @@
 #include <musique/guard.hh>
 #include <musique/interpreter/env.hh>
 #include <musique/interpreter/interpreter.hh>
+#include <musique/interpreter/track.hh>
 #include <musique/random.hh>
 #include <musique/try.hh>
 #include <random>
@@ -144,12 +145,74 @@ Forward_Implementation(builtin_bpm, ctx_read_write_property<&Context::bpm>)
 //: ```
 Forward_Implementation(builtin_oct, ctx_read_write_property<&Context::octave>)
 
+//: Funkcja `lookahead` pozwala na zapisywanie i odczytywanie z aktualnego kontekstu, jak daleko przed odtwarzaniem obliczana jest muzyka.
+//:
+//: Wartość ta jest długością nuty: po `lookahead 1` kolejne elementy sekwencji są obliczane o cały takt wcześniej,
+//: niż zostaną odegrane, więc kosztowne obliczenia nie powodują przerw w muzyce.
+//:
+//: Domyślną wartością jest 0.
+//: # Obliczanie muzyki o ćwierćnutę przed jej odegraniem
+//: ```
+//: > lookahead (1/4)
+//: ```
+Forward_Implementation(builtin_lookahead, ctx_read_write_property<&Context::lookahead>)
+
+//: Funkcja `underruns` zwraca ile razy muzyka została obliczona później, niż powinna zacząć być odgrywana, gdy `lookahead` był włączony.
+//:
+//: # Przykład
+//: ```
+//: > call underruns
+//: 0
+//: ```
+/// Count of lookahead window underruns
+static Result<Value> builtin_underruns(Interpreter &interpreter, std::vector<Value>)
+{
+	return Number(interpreter.lookahead_underruns);
+}
+
+//: Funkcja `voices` zwraca ile nut zostało włączonych i jeszcze nie wyłączonych na danym kanale.
+//: Wywołana bez argumentów zwraca tę liczbę dla wszystkich kanałów.
+//:
+//: Nuty są liczone w chwili wysłania ich komunikatów, a nie zaplanowania, więc wywołana w trakcie
+//: odtwarzania muzyki (na przykład z `lookahead`) pokazuje ile nut właśnie brzmi.
+//:
+//: # Przykład
+//: ```
+//: > note_on 1 60 127
+//: > voices 1
+//: 1
+//: ```
+/// Count of notes sounding on channel or on all channels
+static Result<Value> builtin_voices(Interpreter &interpreter, std::vector<Value> args)
+{
+	if (args.empty()) {
+		return Number(interpreter.output.voices.count());
+	}
+
+	if (auto a = match<Number>(args)) {
+		auto [chan] = *a;
+		return Number(interpreter.output.voices.count(u8(chan.as_int())));
+	}
+
+	return Error {
+		.details = errors::Unsupported_Types_For {
+			.type = errors::Unsupported_Types_For::Function,
+			.name = "voices",
+			.possibilities = {
+				"() -> number",
+				"(number) -> number",
+			}
+		},
+		.location = {}
+	};
+}
+
 /// Iterate over array and it's subarrays to create one flat array
 static Result<Array> into_flat_array(Interpreter &interpreter, std::span<Value> args)
 {
 	Array target;
 	for (auto &arg : args) {
-		std::visit(Overloaded {
+		visit_unboxed(Overloaded {
 			[&target](Array &&array) -> std::optional<Error> {
 				std::move(array.elements.begin(), array.elements.end(), std::back_inserter(target.elements));
 				return {};
@@ -268,12 +331,12 @@ static Result<Value> range(Interpreter&, std::vector<Value> args)
 
 	Array array;
 	if constexpr (dir == Range_Direction::Up) {
-		for (; start < stop; start += step) {
+		for (; start < stop; start = Try(start + step)) {
 			array.elements.push_back(start);
 		}
 	} else {
-		for (; stop > start; stop -= step) {
-			array.elements.push_back(stop - Number(1));
+		for (; stop > start; stop = Try(stop - step)) {
+			array.elements.push_back(Try(stop - Number(1)));
 		}
 	}
 	return array;
@@ -322,13 +385,13 @@ Forward_Implementation(builtin_down, range<Range_Direction::Down>)
 static auto builtin_program_change(Interpreter &i, std::vector<Value> args) -> Result<Value> {
 	if (auto a = match<Number>(args)) {
 		auto [program] = *a;
-		i.current_context->port->send_program_change(0, program.as_int());
+		i.send({ midi::Message::Type::Program_Change, 0, u8(program.as_int()) });
 		return Value{};
 	}
 
 	if (auto a = match<Number, Number>(args)) {
 		auto [chan, program] = *a;
-		i.current_context->port->send_program_change(chan.as_int(), program.as_int());
+		i.send({ midi::Message::Type::Program_Change, u8(chan.as_int()), u8(program.as_int()) });
 		return Value{};
 	}
 
@@ -348,15 +411,15 @@ static auto builtin_program_change(Interpreter &i, std::vector<Value> args) -> R
 /// Plays sequentialy notes walking into arrays and evaluation blocks
 ///
 /// @invariant default_action is play one
-static inline std::optional<Error> sequential_play(Interpreter &i, Value v)
+static inline std::optional<Error> sequential_play(Interpreter &i, Value const& v)
 {
 	if (auto array = get_if<Array>(v)) {
-		for (auto &el : array->elements) {
-			Try(sequential_play(i, std::move(el)));
+		for (auto const& el : array->elements) {
+			Try(sequential_play(i, el));
 		}
 	}
 	else if (auto block = get_if<Block>(v)) {
-		Try(sequential_play(i, Try(i.eval(std::move(block->body)))));
+		Try(sequential_play(i, Try(i.eval(block->body, *block->body))));
 	}
 	else if (auto chord = get_if<Chord>(v)) {
 		return i.play(*chord);
@@ -368,7 +431,7 @@ static inline std::optional<Error> sequential_play(Interpreter &i, Value v)
 /// Play what's given
 static std::optional<Error> action_play(Interpreter &i, Value v)
 {
-	Try(sequential_play(i, std::move(v)));
+	Try(sequential_play(i, v));
 	return {};
 }
 
@@ -393,7 +456,7 @@ static inline Result<Value> builtin_play(Interpreter &interpreter, Container arg
 	};
 
 	for (auto &el : args) {
-		if (std::optional<Error> error = sequential_play(interpreter, std::move(el))) {
+		if (std::optional<Error> error = sequential_play(interpreter, el)) {
 			finally();
 			return *std::move(error);
 		}
@@ -415,7 +478,7 @@ static Result<Value> builtin_par(Interpreter &interpreter, std::vector<Value> ar
 
 	ensure(args.size() >= 1, "par only makes sense for at least one argument"); // TODO(assert)
 	if (args.size() == 1) {
-		auto chord = get_if<Chord>(args.front());
+		auto chord = unshare<Chord>(args.front());
 		ensure(chord, "Par expects music value as first argument"); // TODO(assert)
 		Try(interpreter.play(std::move(*chord)));
 		return Value{};
@@ -423,16 +486,15 @@ static Result<Value> builtin_par(Interpreter &interpreter, std::vector<Value> ar
 
 	// Create chord that should sustain during playing of all other notes
 	auto &ctx = *interpreter.current_context;
-	auto chord = get_if<Chord>(args.front());
+	auto chord = unshare<Chord>(args.front());
 	ensure(chord, "par expects music value as first argument"); // TODO(assert)
 
-	std::for_each(chord->notes.begin(), chord->notes.end(), [&](Note &note) { note = ctx.fill(note); });
+	ctx.fill(*chord);
 
 	for (auto const& note : chord->notes) {
 		if (note.base) {
 			auto const n = *note.into_midi_note();
-			interpreter.current_context->port->send_note_on(0, n, 127);
-			interpreter.active_notes.insert({ 0, n });
+			interpreter.send({ midi::Message::Type::Note_On, 0, n, 127 });
 		}
 	}
 
@@ -441,130 +503,28 @@ static Result<Value> builtin_par(Interpreter &interpreter, std::vector<Value> ar
 	for (auto const& note : chord->notes) {
 		if (note.base) {
 			auto const n = *note.into_midi_note();
-			interpreter.current_context->port->send_note_off(0, n, 127);
-			interpreter.active_notes.erase({ 0, n });
+			interpreter.send({ midi::Message::Type::Note_Off, 0, n, 127 });
 		}
 	}
 	return result;
 }
 
 //: Funkcja `sim` odgrywa zadane sekwencje symultanicznie.
+//: Sekwencje mogą zawierać dowolny kod, który jest wykonywany w chwili, gdy odtwarzanie danej sekwencji do niego dotrze.
 //:
 //: # Przykład
 //: ```
 //: > A := c e g d
 //: > B := f f a a
 //: > sim A B
+//: > sim (play c, say 42, play d) (play e f)
 //: ```
 /// Plays each argument simultaneously
 static Result<Value> builtin_sim(Interpreter &interpreter, std::vector<Value> args)
 {
-	// Simplest solution that will allow arbitrary code will be to clone Interpreter
-	// and execute code recording all messages that are beeing sent. Then sort it
-	// accordingly and start playing. Unfortuanatelly this solution will not respect
-	// cause and effect chains - [play c; say 42; play d] will first say 42,
-	// then play c and d
-	//
-	// The next solution is to run code in multithreaded context, making sure that
-	// all operations will be locked accordingly. This would require support from
-	// parser to well behave under multithreaded environment which now cannot be
-	// guaranteeed.
-	//
-	// The final solution which is only partially working is to traverse arguments
-	// in this function and build a schedule that will be executed
-
-	// 1. Resolve all notes from arguments to tracks
-
-	std::vector<std::vector<Chord>> tracks(args.size());
-
-	struct {
-		Interpreter &interpreter;
-
-		std::optional<Error> operator()(std::vector<Chord> &track, Value &arg)
-		{
-			if (auto chord = get_if<Chord>(arg)) {
-				track.push_back(*chord);
-				return {};
-			}
-
-			if (auto collection = get_if<Collection>(arg)) {
-				for (auto i = 0u; i < collection->size(); ++i) {
-					auto value = Try(collection->index(interpreter, i));
-					Try((*this)(track, value));
-				}
-				return {};
-			}
-
-			// Invalid type for sim function
-			return Error{errors::Unsupported_Types_For {
-				.type = errors::Unsupported_Types_For::Function,
-				.name = "sim",
-				.possibilities = {
-					"(music | array of music)+"
-				},
-			}};
-		}
-	} append { interpreter };
-
-	for (auto i = 0u; i < args.size(); ++i) {
-		Try(append(tracks[i], args[i]));
-	}
-
-	// 2. Translate tracks of notes into one timeline with on and off messages
-	struct Instruction
-	{
-		Number when;
-		enum { On, Off } action;
-		uint8_t note;
-	};
-	std::vector<Instruction> schedule;
-
-	auto const& ctx = *interpreter.current_context;
-
-	for (auto const& track : tracks) {
-		auto passed_time = Number(0);
-
-		for (auto const& chord : track) {
-			auto chord_length = Number(0);
-			for (auto &note : chord.notes) {
-				auto n = ctx.fill(note);
-				auto const length = n.length.value();
-
-				if (note.base) {
-					auto const midi_note = n.into_midi_note().value();
-					schedule.push_back({ .when = passed_time,          .action = Instruction::On,  .note = midi_note });
-					schedule.push_back({ .when = passed_time + length, .action = Instruction::Off, .note = midi_note });
-				}
-
-				chord_length = std::max(n.length.value(), chord_length);
-			}
-			passed_time += chord_length;
-		}
-	}
-
-	// 3. Sort timeline so events will be played at right time
-	std::sort(schedule.begin(), schedule.end(), [](Instruction const& lhs, Instruction const& rhs) {
-		return lhs.when < rhs.when;
-	});
-
-	// 4. Play according to timeline
-	auto start_time = std::chrono::duration<float>(0);
-	for (auto const& instruction : schedule) {
-		auto const dur = ctx.length_to_duration({instruction.when});
-		if (start_time < dur) {
-			interpreter.sleep(dur - start_time);
-			start_time = dur;
-		}
-		switch (instruction.action) {
-		break; case Instruction::On:
-			interpreter.current_context->port->send_note_on(0, instruction.note, 127);
-			interpreter.active_notes.insert({ 0, instruction.note });
-		break; case Instruction::Off:
-			interpreter.current_context->port->send_note_off(0, instruction.note, 127);
-			interpreter.active_notes.erase({ 0, instruction.note });
-		}
-	}
-
+	Try(ensure_midi_connection_available(interpreter, "sim"));
+	Try(play_simultaneously(interpreter, std::move(args)));
+	interpreter.wait_for_playback();
 	return Value{};
 }
 
@@ -789,7 +749,7 @@ static Result<Value> builtin_scan(Interpreter &interpreter, std::vector<Value> a
 //: 0
 //: ```
 /// Execute blocks depending on condition
-static Result<Value> builtin_if(Interpreter &i, std::span<Ast> args)  {
+static Result<Value> builtin_if(Interpreter &i, std::span<Ast const> args)  {
 	static constexpr auto guard = Guard<2> {
 		.name = "if",
 		.possibilities = {
@@ -802,17 +762,20 @@ static Result<Value> builtin_if(Interpreter &i, std::span<Ast> args)  {
 		return guard.yield_error();
 	}
 
-	if (Try(i.eval((Ast)args.front())).truthy()) {
+	// Chosen branch is in tail position of if, so calls in it can be tail calls
+	auto const tail = i.macro_in_tail_position;
+
+	if (Try(i.eval(args.front())).truthy()) {
 		if (args[1].type == Ast::Type::Block) {
-			return Try(i.eval((Ast)args[1].arguments.front()));
+			return i.eval(args[1].arguments.front(), tail);
 		} else {
-			return Try(i.eval((Ast)args[1]));
+			return i.eval(args[1], tail);
 		}
 	} else if (args.size() == 3) {
 		if (args[2].type == Ast::Type::Block) {
-			return Try(i.eval((Ast)args[2].arguments.front()));
+			return i.eval(args[2].arguments.front(), tail);
 		} else {
-			return Try(i.eval((Ast)args[2]));
+			return i.eval(args[2], tail);
 		}
 	}
 
@@ -832,7 +795,7 @@ static Result<Value> builtin_if(Interpreter &i, std::span<Ast> args)  {
 //: 8
 //: ```
 /// Loop block depending on condition
-static Result<Value> builtin_while(Interpreter &i, std::span<Ast> args)  {
+static Result<Value> builtin_while(Interpreter &i, std::span<Ast const> args)  {
 	static constexpr auto guard = Guard<2> {
 		.name = "while",
 		.possibilities = {
@@ -844,11 +807,11 @@ static Result<Value> builtin_while(Interpreter &i, std::span<Ast> args)  {
 		return guard.yield_error();
 	}
 
-	while (Try(i.eval((Ast)args.front())).truthy()) {
+	while (Try(i.eval(args.front())).truthy()) {
 		if (args[1].type == Ast::Type::Block) {
-			Try(i.eval((Ast)args[1].arguments.front()));
+			Try(i.eval(args[1].arguments.front()));
 		} else {
-			Try(i.eval((Ast)args[1]));
+			Try(i.eval(args[1]));
 		}
 	}
 	return Value{};
@@ -869,13 +832,13 @@ static Result<Value> builtin_while(Interpreter &i, std::span<Ast> args)  {
 //: >
 //: ```
 /// Try executing all but last block and if it fails execute last one
-static Result<Value> builtin_try(Interpreter &interpreter, std::span<Ast> args)
+static Result<Value> builtin_try(Interpreter &interpreter, std::span<Ast const> args)
 {
 	if (args.size() == 1) {
 		// TODO This should be abstracted
 		auto result = (args[0].type == Ast::Type::Block)
-			? interpreter.eval((Ast)args[0].arguments.front())
-			: interpreter.eval((Ast)args[0]);
+			? interpreter.eval(args[0].arguments.front())
+			: interpreter.eval(args[0]);
 		return result.value_or(Value{});
 	}
 
@@ -883,8 +846,8 @@ static Result<Value> builtin_try(Interpreter &interpreter, std::span<Ast> args)
 
 	for (auto const& node : args.subspan(0, args.size()-1)) {
 		auto result = (node.type == Ast::Type::Block)
-			? interpreter.eval((Ast)node.arguments.front())
-			: interpreter.eval((Ast)node);
+			? interpreter.eval(node.arguments.front())
+			: interpreter.eval(node);
 
 		if (result.has_value()) {
 			success = *result;
@@ -892,8 +855,8 @@ static Result<Value> builtin_try(Interpreter &interpreter, std::span<Ast> args)
 		}
 
 		return (args.back().type == Ast::Type::Block)
-			? interpreter.eval((Ast)args.back().arguments.front())
-			: interpreter.eval((Ast)args.back());
+			? interpreter.eval(args.back().arguments.front())
+			: interpreter.eval(args.back());
 	}
 
 	return success;
@@ -925,14 +888,14 @@ static Result<Value> builtin_update(Interpreter &i, std::vector<Value> args)
 
 	if (auto a = match<Array, Number, Value>(args)) {
 		auto& [v, index, value] = *a;
-		v.elements[index.as_int()] = std::move(std::move(value));
-		return std::move(v);
+		unshare<Array>(args.front())->elements[index.as_int()] = std::move(value);
+		return std::move(args.front());
 	}
 
-	if (auto a = match<Block, Number, Value>(args)) {
-		auto& [v, index, value] = *a;
-		auto array = Try(flatten(i, { std::move(v) }));
-		array[index.as_int()] = std::move(args.back());
+	if (match<Block, Number, Value>(args)) {
+		auto const index = get_if<Number>(args[1]);
+		auto array = Try(flatten(i, { std::move(args.front()) }));
+		array[index->as_int()] = std::move(args.back());
 		return array;
 	}
 
@@ -974,6 +937,23 @@ static Result<Value> builtin_len(Interpreter &i, std::vector<Value> args)
 
 Result<Value> traverse(Interpreter &interpreter, Value &&value, auto &&lambda)
 {
+	// Lambdas that only read chords are given shared ones, without copying anything
+	constexpr bool read_only = std::is_invocable_v<decltype(lambda), Chord const&>;
+
+	// Arrays are updated in place, so only elements that are changed are copied
+	if (holds_alternative<Array>(value)) {
+		if constexpr (read_only) {
+			for (auto const& element : get_if<Array>(std::as_const(value))->elements) {
+				Try(traverse(interpreter, Value(element), lambda));
+			}
+		} else {
+			for (auto &element : unshare<Array>(value)->elements) {
+				element = Try(traverse(interpreter, std::move(element), lambda));
+			}
+		}
+		return value;
+	}
+
 	if (auto collection = get_if<Collection>(value)) {
 		std::vector<Value> flat;
 		for (auto i = 0u; i < collection->size(); ++i) {
@@ -983,11 +963,13 @@ Result<Value> traverse(Interpreter &interpreter, Value &&value, auto &&lambda)
 		return flat;
 	}
 
-	std::visit([&lambda]<typename T>(T &value) {
-		if constexpr (requires { {lambda(value)}; }) {
-			lambda(value);
+	if (holds_alternative<Chord>(value)) {
+		if constexpr (read_only) {
+			lambda(*get_if<Chord>(std::as_const(value)));
+		} else {
+			lambda(*unshare<Chord>(value));
 		}
-	}, value.data);
+	}
 	return value;
 }
 
@@ -1079,14 +1061,22 @@ static Result<Value> builtin_set_oct(Interpreter &interpreter, std::vector<Value
 static Result<Value> builtin_duration(Interpreter &interpreter, std::vector<Value> args)
 {
 	auto total = Number{};
+	std::optional<Error> overflow;
 	for (auto &arg : args) {
-		Try(traverse(interpreter, std::move(arg), [&](Chord &c) {
+		Try(traverse(interpreter, std::move(arg), [&](Chord const& c) {
 			auto chord_length = Number();
-			for (Note &note : c.notes) {
+			for (Note const& note : c.notes) {
 				chord_length = std::max(chord_length, note.length ? *note.length : interpreter.current_context->length);
 			}
-			total += chord_length;
+			if (auto sum = total + chord_length) {
+				total = *sum;
+			} else {
+				overflow = std::move(sum).error();
+			}
 		}));
+		if (overflow) {
+			return *std::move(overflow);
+		}
 	}
 	return total;
 }
@@ -1127,6 +1117,7 @@ static Result<Value> builtin_seed(Interpreter &interpreter, std::vector<Value> a
 	break; case 1:
 		if (auto a = match<Number>(args)) {
 			auto [s] = *a;
+			s.simplify_inplace();
 			if (s.den == 1) {
 				seed = s.num;
 			} else {
@@ -1211,6 +1202,16 @@ static Result<Value> builtin_permute(Interpreter &i, std::vector<Value> args)
 /// Sort arguments
 static Result<Value> builtin_sort(Interpreter &i, std::vector<Value> args)
 {
+	// Single array without nested collections is sorted in its own storage, copied only when shared
+	if (args.size() == 1) {
+		auto const array = get_if<Array>(std::as_const(args.front()));
+		if (array && std::none_of(array->elements.begin(), array->elements.end(), [](Value const& v) { return get_if<Collection>(v) != nullptr; })) {
+			auto &elements = unshare<Array>(args.front())->elements;
+			std::sort(elements.begin(), elements.end());
+			return std::move(args.front());
+		}
+	}
+
 	auto array = Try(flatten(i, std::move(args)));
 	std::sort(array.begin(), array.end());
 	return array;
@@ -1422,7 +1423,7 @@ static Result<Value> builtin_note_on(Interpreter &interpreter, std::vector<Value
 {
 	if (auto a = match<Number, Number, Number>(args)) {
 		auto [chan, note, vel] = *a;
-		interpreter.current_context->port->send_note_on(chan.as_int(), note.as_int(), vel.as_int());
+		interpreter.send({ midi::Message::Type::Note_On, u8(chan.as_int()), u8(note.as_int()), u8(vel.as_int()) });
 		return Value {};
 	}
 
@@ -1430,7 +1431,7 @@ static Result<Value> builtin_note_on(Interpreter &interpreter, std::vector<Value
 		auto [chan, chord, vel] = *a;
 		for (auto note : chord.notes) {
 			note = interpreter.current_context->fill(note);
-			interpreter.current_context->port->send_note_on(chan.as_int(), *note.into_midi_note(), vel.as_int());
+			interpreter.send({ midi::Message::Type::Note_On, u8(chan.as_int()), *note.into_midi_note(), u8(vel.as_int()) });
 		}
 		return Value{};
 	}
@@ -1459,7 +1460,7 @@ static Result<Value> builtin_note_off(Interpreter &interpreter, std::vector<Valu
 {
 	if (auto a = match<Number, Number>(args)) {
 		auto [chan, note] = *a;
-		interpreter.current_context->port->send_note_off(chan.as_int(), note.as_int(), 127);
+		interpreter.send({ midi::Message::Type::Note_Off, u8(chan.as_int()), u8(note.as_int()), 127 });
 		return Value {};
 	}
 
@@ -1468,7 +1469,7 @@ static Result<Value> builtin_note_off(Interpreter &interpreter, std::vector<Valu
 
 		for (auto note : chord.notes) {
 			note = interpreter.current_context->fill(note);
-			interpreter.current_context->port->send_note_off(chan.as_int(), *note.into_midi_note(), 127);
+			interpreter.send({ midi::Message::Type::Note_Off, u8(chan.as_int()), *note.into_midi_note(), 127 });
 		}
 		return Value{};
 	}
@@ -1630,21 +1631,59 @@ static Result<Value> builtin_call(Interpreter &i, std::vector<Value> args)
 
 //: Rozpocznij równo z podłączonymi instancjami w sieci dane fragment kodu
 //:
+//: Kod zaczyna się wraz z następnym taktem sesji Ableton Link, a wszystkie jego nuty
+//: są odtwarzane w rytmie sesji, więc pozostają zgrane z innymi instancjami aż do końca.
+//: Jeżeli w sieci nie ma innych instancji, tempo sesji jest ustawiane na aktualne `bpm`.
+//:
 //: # Przykład
 //: ```
 //: start (play (c, e, g))
 //: ```
-static Result<Value> builtin_start(Interpreter &interpreter, std::span<Ast> args)
+static Result<Value> builtin_start(Interpreter &interpreter, std::span<Ast const> args)
 {
-	interpreter.starter.start();
-	auto result = algo::fold(args, Value{}, [&interpreter](auto const&, Ast const& ast)
-		-> Result<Value>
+	auto const eval_all = [&] {
+		return algo::fold(args, Value{}, [&interpreter](auto const&, Ast const& ast) -> Result<Value> {
+			return Try(interpreter.eval(ast));
+		});
+	};
+
+	// Virtual clock plays music without waiting, so there is nobody to synchronize with
+	if (interpreter.clock->is_virtual()) {
+		return eval_all();
+	}
+
+	/// Plays following Link timeline until end of start, also when leaving it with an error or an interrupt
+	///
+	/// Clock itself is kept, only its timeline is switched, since interrupts may reach it at any time.
+	struct Session
 	{
-		return Try(interpreter.eval((Ast)ast));
-	});
-	// FIXME this should be in "finally" block
-	interpreter.starter.stop();
-	return result;
+		Interpreter &interpreter;
+		Real_Time_Clock &clock;
+		std::unique_ptr<Timeline> previous;
+		std::chrono::steady_clock::time_point origin;
+
+		Session(Interpreter &interpreter)
+			: interpreter(interpreter), clock(static_cast<Real_Time_Clock&>(*interpreter.clock))
+		{
+			auto timeline = interpreter.starter.start(interpreter.current_context->bpm);
+			origin = timeline->origin;
+			interpreter.playback_time = origin;
+			previous = std::exchange(clock.timeline, std::move(timeline));
+		}
+
+		~Session()
+		{
+			// Following music continues in real time from where this one ended
+			if (interpreter.playback_time) {
+				interpreter.playback_time = clock.real_time(*interpreter.playback_time);
+			}
+			clock.timeline = std::move(previous);
+			interpreter.starter.stop();
+		}
+	} session(interpreter);
+
+	interpreter.sleep_until(session.origin);
+	return eval_all();
 }
 
 //: Wypisz liczbę podłączonych instancji w sieci
@@ -1688,7 +1727,8 @@ static Result<Value> builtin_remap(Interpreter &interpreter, std::vector<Value>
 
 	if (auto a = match<Number, Number, Number, Number, Number>(args)) {
 		auto [value, start1, stop1, start2, stop2] = *a;
-		return Try((value - start1) / (stop1 - start1)) * (stop2 - start2) + start2;
+		auto const scaled = Try(Try(Try(value - start1) / Try(stop1 - start1)) * Try(stop2 - start2));
+		return Try(scaled + start2);
 	}
 
 	if (auto a = match<Number, Number, Number, Chord, Chord>(args)) {
@@ -1706,6 +1746,160 @@ static Result<Value> builtin_remap(Interpreter &interpreter, std::vector<Value>
 	return guard.yield_error();
 }
 
+//: Funkcja `input` ustawia wejście MIDI, z którego funkcja `receive` odbiera komunikaty.
+//:
+//: Dostępne opcje to numer portu, symbol `'virtual` tworzący wirtualny port MIDI
+//: oraz ścieżka do pliku z zapisanymi komunikatami w formacie `@0.500 note-on 0 60 127`,
+//: które nadchodzą w zapisanym czasie liczonym od wywołania `input`.
+//:
+//: # Przykład
+//:
+//: ```
+//: > input 0
+//: > input 'virtual
+//: > input 'nagranie.txt
+//: ```
+/// Choose MIDI input
+static Result<Value> builtin_input(Interpreter &interpreter, std::vector<Value> args)
+{
+	if (auto a = match<Number>(args)) {
+		auto [port_number] = *a;
+		auto input = std::make_shared<midi::Rt_Midi_Input>();
+		input->connect_input(port_number.floor().as_int());
+		interpreter.input = std::move(input);
+		return {};
+	}
+
+	if (auto a = match<Symbol>(args)) {
+		auto [name] = *a;
+		if (name == "virtual") {
+			auto input = std::make_shared<midi::Rt_Midi_Input>();
+			input->connect_input();
+			interpreter.input = std::move(input);
+			return {};
+		}
+
+		auto input = std::make_shared<midi::File_Input>();
+		if (!input->load(name.view(), interpreter.now())) {
+			return Error {
+				.details = errors::Failed_To_Read_Midi_File { .path = std::string(name.view()) },
+			};
+		}
+		interpreter.input = std::move(input);
+		return {};
+	}
+
+	return Error {
+		.details = errors::Unsupported_Types_For {
+			.type = errors::Unsupported_Types_For::Function,
+			.name = "input",
+			.possibilities = {
+				"(number) -> nil",
+				"(symbol) -> nil",
+			}
+		},
+		.location = {}
+	};
+}
+
+//: Funkcja `receive` odbiera komunikat z wejścia MIDI ustawionego funkcją `input`.
+//:
+//: Komunikat jest tablicą złożoną z jego rodzaju (`note_on`, `note_off`, `program_change`
+//: lub `controller_change`), kanału i bajtów danych. Wywołana bez argumentów czeka na komunikat,
+//: z podaną długością nuty czeka najwyżej tyle i zwraca `nil`, jeżeli komunikat nie nadszedł.
+//:
+//: # Przykład
+//:
+//: ```
+//: > input 'virtual
+//: > call receive
+//: (note_on, 0, 60, 127)
+//: > receive 0
+//: nil
+//: ```
+/// Receive message from MIDI input
+static Result<Value> builtin_receive(Interpreter &interpreter, std::vector<Value> args)
+{
+	std::optional<std::chrono::steady_clock::time_point> deadline;
+	if (auto a = match<Number>(args)) {
+		auto [length] = *a;
+		deadline = interpreter.now() + interpreter.current_context->length_to_duration(length);
+	} else if (!args.empty()) {
+		return Error {
+			.details = errors::Unsupported_Types_For {
+				.type = errors::Unsupported_Types_For::Function,
+				.name = "receive",
+				.possibilities = {
+					"() -> array | nil",
+					"(number) -> array | nil",
+				}
+			},
+			.location = {}
+		};
+	}
+
+	if (!interpreter.input) {
+		return Error {
+			.details = errors::Operation_Requires_Midi_Connection {
+				.is_input = true,
+				.name = "receive",
+			},
+			.location = {}
+		};
+	}
+
+	auto const received = interpreter.receive(deadline);
+	if (!received) {
+		return Value{};
+	}
+
+	auto const& message = received->message;
+	std::vector<Value> result;
+	switch (message.type) {
+	break; case midi::Message::Type::Note_On:           result.push_back(Symbol("note_on"));
+	break; case midi::Message::Type::Note_Off:          result.push_back(Symbol("note_off"));
+	break; case midi::Message::Type::Program_Change:    result.push_back(Symbol("program_change"));
+	break; case midi::Message::Type::Controller_Change: result.push_back(Symbol("controller_change"));
+	}
+	result.push_back(Number(message.channel));
+	result.push_back(Number(message.first));
+	if (message.data_size() == 2) {
+		result.push_back(Number(message.second));
+	}
+	return Value(std::move(result));
+}
+
+//: Funkcja `latency` zwraca opóźnienie odpowiedzi na komunikaty odebrane funkcją `receive`,
+//: czyli czas od nadejścia komunikatu do faktycznego wysłania pierwszego komunikatu po nim.
+//:
+//: Wynikiem jest tablica złożona z liczby pomiarów oraz najmniejszego, średniego i największego opóźnienia w milisekundach.
+//: Jeżeli nie było jeszcze żadnego pomiaru, tablica zawiera tylko liczbę pomiarów.
+//:
+//: # Przykład
+//:
+//: ```
+//: > call latency
+//: (12, 1/5, 1/2, 3)
+//: ```
+/// Report latency between received and sent messages
+static Result<Value> builtin_latency(Interpreter &interpreter, std::vector<Value>)
+{
+	auto const latency = interpreter.output.latency();
+	if (latency.count == 0) {
+		return Value(std::vector<Value> { Number(0) });
+	}
+
+	auto const in_milliseconds = [](std::chrono::steady_clock::duration duration) {
+		return Number(std::chrono::duration_cast<std::chrono::microseconds>(duration).count(), 1000);
+	};
+	return Value(std::vector<Value> {
+		Number(latency.count),
+		in_milliseconds(latency.min),
+		in_milliseconds(latency.total / latency.count),
+		in_milliseconds(latency.max),
+	});
+}
+
 //: Ustaw wyjście MIDI w danym kontekście na dany port
 //:
 //: Dostępne opcje to numer portu oraz symbol `'virtual` tworzacy port wirtualny MIDI
@@ -1772,8 +1966,11 @@ void Interpreter::register_builtin_functions()
 	global.force_define("for",            builtin_for);
 	global.force_define("hash",           builtin_hash);
 	global.force_define("if",             builtin_if);
+	global.force_define("input",          builtin_input);
 	global.force_define("instrument",     builtin_program_change);
+	global.force_define("latency",        builtin_latency);
 	global.force_define("len",            builtin_len);
+	global.force_define("lookahead",      builtin_lookahead);
 	global.force_define("map",            builtin_map);
 	global.force_define("max",            builtin_max);
 	global.force_define("min",            builtin_min);
@@ -1792,6 +1989,7 @@ void Interpreter::register_builtin_functions()
 	global.force_define("port",           builtin_port);
 	global.force_define("program_change", builtin_program_change);
 	global.force_define("range",          builtin_range);
+	global.force_define("receive",        builtin_receive);
 	global.force_define("remap",          builtin_remap);
 	global.force_define("reverse",        builtin_reverse);
 	global.force_define("rotate",         builtin_rotate);
@@ -1806,9 +2004,11 @@ void Interpreter::register_builtin_functions()
 	global.force_define("start",          builtin_start);
 	global.force_define("try",            builtin_try);
 	global.force_define("typeof",         builtin_typeof);
+	global.force_define("underruns",      builtin_underruns);
 	global.force_define("uniq",           builtin_uniq);
 	global.force_define("unique",         builtin_unique);
 	global.force_define("up",             builtin_up);
 	global.force_define("update",         builtin_update);
+	global.force_define("voices",         builtin_voices);
 	global.force_define("while",          builtin_while);
 }
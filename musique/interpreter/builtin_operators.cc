@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <functional>
 #include <musique/algo.hh>
 #include <musique/guard.hh>
@@ -15,6 +16,7 @@ static Result<Value> vectorize(auto &&operation, Interpreter &interpreter, Value
 
 	if (lhs_coll != nullptr && rhs_coll == nullptr) {
 		Array array;
+		array.elements.reserve(lhs_coll->size());
 		for (auto i = 0u; i < lhs_coll->size(); ++i) {
 			array.elements.push_back(
 				Try(operation(interpreter, { Try(lhs_coll->index(interpreter, i)), rhs })));
@@ -25,6 +27,7 @@ static Result<Value> vectorize(auto &&operation, Interpreter &interpreter, Value
 	ensure(rhs_coll != nullptr, "Trying to vectorize two non-collections");
 
 	Array array;
+	array.elements.reserve(rhs_coll->size());
 	for (auto i = 0u; i < rhs_coll->size(); ++i) {
 		array.elements.push_back(
 			Try(operation(interpreter, { lhs, Try(rhs_coll->index(interpreter, i)) })));
@@ -40,6 +43,46 @@ static Result<Value> vectorize(auto &&operation, Interpreter &interpreter, std::
 	return vectorize(std::move(operation), interpreter, std::move(args.front()), std::move(args.back()));
 }
 
+/// Faster vectorization primitive for arrays that hold only values of type T
+///
+/// Operation is applied to each element directly, either updating it in place or returning value
+/// that replaces it, so temporary arrays like `up 128` are transformed without any allocation.
+/// Returns nullopt when value is not such array.
+template<typename T>
+static std::optional<Result<Value>> vectorize_elements(Value &value, auto &&operation)
+{
+	auto const array = get_if<Array>(std::as_const(value));
+	if (array == nullptr || !std::ranges::all_of(array->elements, [](Value const& v) { return holds_alternative<T>(v); })) {
+		return std::nullopt;
+	}
+
+	for (auto &element : unshare<Array>(value)->elements) {
+		auto &object = *unshare<T>(element);
+		using Result_Type = decltype(operation(object));
+		if constexpr (std::is_void_v<Result_Type>) {
+			operation(object);
+		} else if constexpr (std::is_same_v<Result_Type, Result<Number>>) {
+			element = Value(Try(operation(object)));
+		} else {
+			element = Value(operation(object));
+		}
+	}
+	return std::move(value);
+}
+
+/// Apply binary operation between array of numbers and number given on the other side
+template<typename Binary_Operation>
+static std::optional<Result<Value>> vectorize_numbers(Value &lhs, Value &rhs)
+{
+	if (auto const scalar = get_if<Number>(rhs)) {
+		return vectorize_elements<Number>(lhs, [scalar = *scalar](Number element) { return Binary_Operation{}(element, scalar); });
+	}
+	if (auto const scalar = get_if<Number>(lhs)) {
+		return vectorize_elements<Number>(rhs, [scalar = *scalar](Number element) { return Binary_Operation{}(scalar, element); });
+	}
+	return std::nullopt;
+}
+
 /// Helper simlifiing implementation of symetric binary operations.
 ///
 /// Calls binary if values matches types any permutation of {t1, t2}, always in shape (t1, t2)
@@ -58,6 +101,18 @@ inline auto symetric(Value &lhs, Value &rhs, auto binary)
 	}
 }
 
+/// Move all notes of chord by given number of semitones
+template<typename Binary_Operation>
+static void transpose(Chord &chord, Number semitones)
+{
+	for (auto &note : chord.notes) {
+		if (note.base) {
+			*note.base = Binary_Operation{}(*note.base, semitones.as_int());
+			note.simplify_inplace();
+		}
+	}
+}
+
 /// Creates implementation of plus/minus operator that support following operations:
 ///   number, number -> number (standard math operations)
 ///   n: number, m: music  -> music
@@ -69,26 +124,45 @@ static Result<Value> builtin_operator_add_subtract(Interpreter &interpreter, std
 		return Number(0);
 	}
 
-	Value init = args.front();
+	// Arguments are owned by the call, so temporary arrays and chords can be transformed in place
+	Value init = std::move(args.front());
 	return algo::fold(std::span(args).subspan(1), std::move(init), [&interpreter](Value lhs, Value &rhs) -> Result<Value> {
 		if (auto a = match<Number, Number>(lhs, rhs)) {
 			return std::apply(Binary_Operation{}, *a);
 		}
 
-		auto result = symetric<Chord, Number>(lhs, rhs, [](Chord &lhs, Number rhs) {
-			for (auto &note : lhs.notes) {
-				if (note.base) {
-					*note.base = Binary_Operation{}(*note.base, rhs.as_int());
-					note.simplify_inplace();
-				}
+		// Music is transposed in place, always in shape (music, number)
+		if (holds_alternative<Chord>(lhs) != holds_alternative<Chord>(rhs)) {
+			auto &music = holds_alternative<Chord>(lhs) ? lhs : rhs;
+			if (auto semitones = get_if<Number>(&music == &lhs ? rhs : lhs)) {
+				transpose<Binary_Operation>(*unshare<Chord>(music), *semitones);
+				return std::move(music);
 			}
-			return lhs;
-		});
-		if (result.has_value()) {
-			return *std::move(result);
 		}
 
 		if (holds_alternative<Collection>(lhs) != holds_alternative<Collection>(rhs)) {
+			if (auto result = vectorize_numbers<Binary_Operation>(lhs, rhs)) {
+				return *std::move(result);
+			}
+			auto &coll = holds_alternative<Collection>(lhs) ? lhs : rhs;
+			if (auto semitones = get_if<Number>(holds_alternative<Collection>(lhs) ? rhs : lhs)) {
+				auto result = vectorize_elements<Chord>(coll, [semitones = *semitones](Chord &chord) {
+					transpose<Binary_Operation>(chord, semitones);
+				});
+				if (result) {
+					return *std::move(result);
+				}
+			}
+			if (auto chord = get_if<Chord>(holds_alternative<Collection>(lhs) ? rhs : lhs)) {
+				auto result = vectorize_elements<Number>(coll, [chord](Number semitones) {
+					auto transposed = *chord;
+					transpose<Binary_Operation>(transposed, semitones);
+					return transposed;
+				});
+				if (result) {
+					return *std::move(result);
+				}
+			}
 			return vectorize(builtin_operator_add_subtract<Binary_Operation>, interpreter, std::move(lhs), std::move(rhs));
 		}
 
@@ -124,6 +198,9 @@ static Result<Value> builtin_operator_arithmetic(Interpreter& interpreter, std::
 			}
 
 			if (holds_alternative<Collection>(lhs) != holds_alternative<Collection>(rhs)) {
+				if (auto result = vectorize_numbers<Binary_Operation>(lhs, rhs)) {
+					return *std::move(result);
+				}
 				return vectorize(builtin_operator_arithmetic<Binary_Operation, Chars...>, interpreter, std::move(lhs), std::move(rhs));
 			}
 
@@ -154,6 +231,15 @@ static Result<Value> builtin_operator_compare(Interpreter &interpreter, std::vec
 		auto coll    = lhs_coll ? lhs_coll     : rhs_coll;
 		auto element = lhs_coll ? &args.back() : &args.front();
 
+		if (auto const scalar = get_if<Number>(*element)) {
+			auto result = vectorize_elements<Number>(lhs_coll ? args.front() : args.back(), [scalar = *scalar](Number n) {
+				return Binary_Predicate{}(n, scalar);
+			});
+			if (result) {
+				return *std::move(result);
+			}
+		}
+
 		std::vector<Value> result;
 		result.reserve(coll->size());
 		for (auto i = 0u; i < coll->size(); ++i) {
@@ -179,8 +265,8 @@ static Result<Value> builtin_operator_multiply(Interpreter &interpreter, std::ve
 	auto init = std::move(args.front());
 	return algo::fold(std::span(args).subspan(1), std::move(init), [&interpreter](Value lhs, Value &rhs) -> Result<Value> {
 		{
-			auto result = symetric<Number, Chord>(lhs, rhs, [](Number lhs, Chord &rhs) {
-				return Array { std::vector<Value>(lhs.floor().as_int(), std::move(rhs)) };
+			auto result = symetric<Number, Chord>(lhs, rhs, [](Number lhs, Chord const& rhs) {
+				return Array { std::vector<Value>(lhs.floor().as_int(), Value(rhs)) };
 			});
 
 			if (result.has_value()) {
@@ -191,6 +277,12 @@ static Result<Value> builtin_operator_multiply(Interpreter &interpreter, std::ve
 			auto result = symetric<Number, Collection>(lhs, rhs, [&interpreter](Number lhs, Collection &rhs) -> Result<Value> {
 				std::vector<Value> values;
 				values.reserve(rhs.size() * lhs.floor().as_int());
+				if (auto array = dynamic_cast<Array const*>(&rhs)) {
+					for (unsigned j = 0; j < lhs.floor().as_int(); ++j) {
+						values.insert(values.end(), array->elements.begin(), array->elements.end());
+					}
+					return values;
+				}
 				for (unsigned j = 0; j < lhs.floor().as_int(); ++j) {
 					for (unsigned i = 0; i < rhs.size(); ++i) {
 						values.push_back(Try(rhs.index(interpreter, i)));
@@ -240,7 +332,7 @@ static Result<Value> builtin_operator_index(Interpreter &interpreter, std::vecto
 		for (size_t n = 0; n < positions.size(); ++n) {
 			auto const v = Try(positions.index(interpreter, n));
 
-			auto index = std::visit(Overloaded {
+			auto index = visit_unboxed(Overloaded {
 				[](Number n) -> std::optional<size_t> { return n.floor().as_int(); },
 				[n](Bool b)  -> std::optional<size_t> { return b ? std::optional(n) : std::nullopt; },
 				[](auto &&)  -> std::optional<size_t> { return std::nullopt; }
@@ -277,19 +369,13 @@ static Result<Value> builtin_operator_join(Interpreter &interpreter, std::vector
 		.type = errors::Unsupported_Types_For::Operator
 	};
 
-	if (auto a = match<Chord, Chord>(args)) {
-		auto [lhs, rhs] = *a;
-		auto &l = lhs.notes, &r = rhs.notes;
-		if (l.size() < r.size()) {
-			std::swap(l, r);
-			std::swap(lhs, rhs);
-		}
-
+	if (match<Chord, Chord>(args)) {
 		// Append one set of notes to another to make bigger chord!
-		l.reserve(l.size() + r.size());
-		std::move(r.begin(), r.end(), std::back_inserter(l));
+		auto &l = unshare<Chord>(args.front())->notes;
+		auto const& r = get_if<Chord>(std::as_const(args.back()))->notes;
+		l.insert(l.end(), r.begin(), r.end());
 
-		return lhs;
+		return std::move(args.front());
 	}
 
 	auto result = Array {};
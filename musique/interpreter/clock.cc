@@ -0,0 +1,172 @@
+#include <musique/interpreter/clock.hh>
+
+#include <algorithm>
+#include <iomanip>
+
+std::chrono::steady_clock::time_point Real_Time_Clock::now() const
+{
+	return timeline ? timeline->now() : std::chrono::steady_clock::now();
+}
+
+bool Real_Time_Clock::sleep_until(std::chrono::steady_clock::time_point time)
+{
+	auto const until = real_time(time);
+	relay.listen();
+	std::unique_lock lock(mu);
+	// Predicate keeps spurious wakeups from looking like interrupts
+	if (condvar.wait_until(lock, until, [this] { return interrupted.load(); })) {
+		interrupted = false;
+		return false;
+	}
+	return true;
+}
+
+void Real_Time_Clock::interrupt()
+{
+	interrupted = true;
+	relay.signal();
+}
+
+bool Real_Time_Clock::is_virtual() const
+{
+	return false;
+}
+
+std::chrono::steady_clock::time_point Real_Time_Clock::real_time(std::chrono::steady_clock::time_point time) const
+{
+	return timeline ? timeline->real_time(time) : time;
+}
+
+Virtual_Clock::Virtual_Clock(std::chrono::steady_clock::time_point start)
+	: start(start), current(start)
+{
+}
+
+std::chrono::steady_clock::time_point Virtual_Clock::now() const
+{
+	return current;
+}
+
+bool Virtual_Clock::sleep_until(std::chrono::steady_clock::time_point time)
+{
+	current = std::max(current, time);
+	return true;
+}
+
+bool Virtual_Clock::is_virtual() const
+{
+	return true;
+}
+
+void Virtual_Clock::record(std::chrono::steady_clock::time_point when, midi::Message message)
+{
+	events.push_back({ .time = when - start, .message = message });
+}
+
+void Virtual_Clock::print_timeline(std::ostream &out)
+{
+	std::stable_sort(events.begin(), events.end(), [](Event const& lhs, Event const& rhs) {
+		return lhs.time < rhs.time;
+	});
+	for (auto const& event : events) {
+		out << event << '\n';
+	}
+	out << std::flush;
+	events.clear();
+}
+
+std::ostream& operator<<(std::ostream& os, Virtual_Clock::Event const& event)
+{
+	auto const milliseconds = std::chrono::round<std::chrono::milliseconds>(event.time).count();
+	return os << "@" << milliseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << milliseconds % 1000
+		<< std::setfill(' ') << ' ' << event.message;
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+#include <sstream>
+#include <thread>
+
+TEST_CASE("Real time clock", "[interpreter]")
+{
+	using namespace std::chrono_literals;
+	Real_Time_Clock clock;
+
+	auto const start = clock.now();
+	REQUIRE(clock.sleep_until(start + 10ms));
+	REQUIRE(clock.now() >= start + 10ms);
+
+	// Interrupt wakes up sleep, which reports it once
+	std::thread interrupter([&clock] {
+		std::this_thread::sleep_for(10ms);
+		clock.interrupt();
+	});
+	REQUIRE(!clock.sleep_until(clock.now() + 1h));
+	interrupter.join();
+	REQUIRE(clock.sleep_until(clock.now() + 1ms));
+
+	// Interrupt issued before sleep isn't lost
+	clock.interrupt();
+	REQUIRE(!clock.sleep_until(clock.now() + 1h));
+}
+
+TEST_CASE("Real time clock follows its timeline", "[interpreter]")
+{
+	using namespace std::chrono_literals;
+
+	/// Timeline running twice as fast as real time from its creation
+	struct Double_Speed : Timeline
+	{
+		std::chrono::steady_clock::time_point origin = std::chrono::steady_clock::now();
+
+		std::chrono::steady_clock::time_point now() const override
+		{
+			return origin + 2 * (std::chrono::steady_clock::now() - origin);
+		}
+
+		std::chrono::steady_clock::time_point real_time(std::chrono::steady_clock::time_point time) const override
+		{
+			return origin + (time - origin) / 2;
+		}
+	};
+
+	Real_Time_Clock clock;
+	clock.timeline = std::make_unique<Double_Speed>();
+	auto const origin = static_cast<Double_Speed&>(*clock.timeline).origin;
+
+	REQUIRE(clock.real_time(origin + 20ms) == origin + 10ms);
+	REQUIRE(clock.sleep_until(origin + 20ms));
+	REQUIRE(std::chrono::steady_clock::now() >= origin + 10ms);
+	REQUIRE(clock.now() >= origin + 20ms);
+
+	// Interrupt reaches sleep following timeline just like one following real time
+	clock.interrupt();
+	REQUIRE(!clock.sleep_until(clock.now() + 1h));
+
+	clock.timeline.reset();
+	REQUIRE(clock.real_time(origin) == origin);
+}
+
+TEST_CASE("Virtual clock", "[interpreter]")
+{
+	using namespace std::chrono_literals;
+	Virtual_Clock clock;
+
+	REQUIRE(clock.sleep_until(clock.start + 2s));
+	REQUIRE(clock.now() == clock.start + 2s);
+
+	// Sleeping until point in the past doesn't move clock back
+	REQUIRE(clock.sleep_until(clock.start + 1s));
+	REQUIRE(clock.now() == clock.start + 2s);
+
+	clock.record(clock.start + 2500ms, { midi::Message::Type::Note_Off, 0, 60, 127 });
+	clock.record(clock.start + 500ms,  { midi::Message::Type::Program_Change, 1, 5 });
+
+	std::stringstream timeline;
+	clock.print_timeline(timeline);
+	REQUIRE(timeline.str() == "@0.500 program-change 1 5\n@2.500 note-off 0 60 127\n");
+	REQUIRE(clock.events.empty());
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef MUSIQUE_CLOCK_HH
+#define MUSIQUE_CLOCK_HH
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <musique/midi/midi.hh>
+#include <musique/signal_relay.hh>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+/// Source of time that interpreter schedules music against
+struct Clock
+{
+	virtual ~Clock() = default;
+
+	/// Current point in time
+	virtual std::chrono::steady_clock::time_point now() const = 0;
+
+	/// Wait until given point in time, returns false when woken up earlier by interrupt
+	///
+	/// Each interrupt makes exactly one call return false, even when it was issued before the call.
+	virtual bool sleep_until(std::chrono::steady_clock::time_point) = 0;
+
+	/// Wake up caller of sleep_until. Safe to call from signal handler
+	virtual void interrupt() {}
+
+	/// Whether time passes only by sleeping, so messages should be delivered immediately instead of on time
+	virtual bool is_virtual() const = 0;
+
+	/// Point in real time that given point in time of this clock happens at
+	///
+	/// Messages are delivered in real time, so their times are converted with it before sending.
+	virtual std::chrono::steady_clock::time_point real_time(std::chrono::steady_clock::time_point time) const { return time; }
+
+	/// Note that message was sent at given point in time
+	///
+	/// Real time clock ignores it, virtual clock records it to allow inspection of timeline.
+	virtual void record(std::chrono::steady_clock::time_point, midi::Message) {}
+};
+
+/// Time flowing at its own pace, mapped onto real time
+struct Timeline
+{
+	virtual ~Timeline() = default;
+
+	/// Current point in time of this timeline
+	virtual std::chrono::steady_clock::time_point now() const = 0;
+
+	/// Point in real time that given point in time of this timeline happens at
+	virtual std::chrono::steady_clock::time_point real_time(std::chrono::steady_clock::time_point time) const = 0;
+};
+
+/// Clock following real time, waiting for it to pass
+struct Real_Time_Clock : Clock
+{
+	~Real_Time_Clock() override = default;
+
+	/// Timeline that clock follows instead of real time, when set
+	///
+	/// Changed only by thread using the clock, while clock itself lives as long as interpreter,
+	/// so interrupts issued from signal handler never reach clock that was already destroyed.
+	std::unique_ptr<Timeline> timeline;
+
+	std::chrono::steady_clock::time_point now() const override;
+	bool sleep_until(std::chrono::steady_clock::time_point) override;
+	void interrupt() override;
+	bool is_virtual() const override;
+	std::chrono::steady_clock::time_point real_time(std::chrono::steady_clock::time_point time) const override;
+
+private:
+	std::condition_variable condvar;
+	std::mutex mu;
+
+	/// Wakes sleep on behalf of interrupt, which can't touch condition variable in signal handler
+	Signal_Relay relay{mu, condvar};
+
+	/// Interrupt issued that no sleep returned false for yet
+	std::atomic<bool> interrupted = false;
+};
+
+/// Clock that jumps instantly to the end of each sleep, recording every message sent
+///
+/// Music played with it is computed as fast as possible, with exact and repeatable timing.
+struct Virtual_Clock : Clock
+{
+	/// Message together with time since clock start it was sent at
+	struct Event
+	{
+		std::chrono::steady_clock::duration time;
+		midi::Message message;
+
+		bool operator==(Event const&) const = default;
+	};
+
+	/// Point in time that clock started at
+	std::chrono::steady_clock::time_point start;
+
+	/// Point in time that clock is currently at
+	std::chrono::steady_clock::time_point current;
+
+	/// Recorded messages, in order they were sent
+	std::vector<Event> events;
+
+	explicit Virtual_Clock(std::chrono::steady_clock::time_point start = {});
+	~Virtual_Clock() override = default;
+
+	std::chrono::steady_clock::time_point now() const override;
+	bool sleep_until(std::chrono::steady_clock::time_point) override;
+	bool is_virtual() const override;
+	void record(std::chrono::steady_clock::time_point, midi::Message) override;
+
+	/// Print recorded events ordered by time, one per line, and forget them
+	void print_timeline(std::ostream &out);
+};
+
+std::ostream& operator<<(std::ostream& os, Virtual_Clock::Event const& event);
+
+#endif // MUSIQUE_CLOCK_HH
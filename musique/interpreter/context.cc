@@ -1,4 +1,5 @@
 #include <musique/interpreter/context.hh>
+#include <musique/value/chord.hh>
 
 Note Context::fill(Note note) const
 {
@@ -7,10 +8,19 @@ Note Context::fill(Note note) const
 	return note;
 }
 
-std::chrono::duration<float> Context::length_to_duration(std::optional<Number> length) const
+void Context::fill(Chord &chord) const
+{
+	for (auto &note : chord.notes) {
+		if (not note.octave) note.octave = octave;
+		if (not note.length) note.length = length;
+	}
+}
+
+std::chrono::steady_clock::duration Context::length_to_duration(std::optional<Number> length) const
 {
 	auto const len = length ? *length : this->length;
-	return std::chrono::duration<float>(float(len.num * (60.f / (float(bpm) / 4))) / len.den);
+	auto const seconds = std::chrono::duration<double>(double(len.num) * (60.0 / (double(bpm) / 4)) / double(len.den));
+	return std::chrono::duration_cast<std::chrono::steady_clock::duration>(seconds);
 }
 
 template<>
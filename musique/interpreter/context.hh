@@ -9,6 +9,8 @@
 #include <musique/value/note.hh>
 #include <musique/value/number.hh>
 
+struct Chord;
+
 namespace midi::connections
 {
 	using Established_Port = unsigned int;
@@ -33,6 +35,9 @@ struct Context
 	/// Default BPM
 	unsigned bpm = 120;
 
+	/// How far ahead of playback music is evaluated and scheduled, as note length
+	Number lookahead = Number(0);
+
 	/// Port that is currently used
 	std::shared_ptr<midi::Connection> port;
 
@@ -49,8 +54,11 @@ struct Context
 	/// Fills empty places in Note like octave and length with default values from context
 	Note fill(Note) const;
 
-	/// Converts length to seconds with current bpm
-	std::chrono::duration<float> length_to_duration(std::optional<Number> length) const;
+	/// Fills empty places of all notes of chord in place, without copying them
+	void fill(Chord &chord) const;
+
+	/// Converts length to time with current bpm
+	std::chrono::steady_clock::duration length_to_duration(std::optional<Number> length) const;
 
 	std::shared_ptr<Context> parent;
 };
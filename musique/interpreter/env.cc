@@ -11,26 +11,71 @@ std::shared_ptr<Env> Env::make()
 	return std::shared_ptr<Env>(new_env);
 }
 
-Env& Env::force_define(std::string name, Value new_value)
+Env& Env::force_define(Symbol name, Value new_value)
 {
-	variables.insert_or_assign(std::move(name), std::move(new_value));
+	// Variables that have a slot are kept only there, so both ways of lookup agree
+	if (layout) {
+		if (auto slot = layout->slot(name)) {
+			slots[*slot] = std::move(new_value);
+			return *this;
+		}
+	}
+	variables.insert_or_assign(name, std::move(new_value));
 	return *this;
 }
 
-Value* Env::find(std::string const& name)
+Env& Env::force_define(Lexical_Address const& address, Symbol name, Value new_value)
+{
+	if (address.frame && address.frame == layout) {
+		slots[address.slot] = std::move(new_value);
+		return *this;
+	}
+	return force_define(name, std::move(new_value));
+}
+
+Value* Env::find(Symbol name)
 {
 	for (Env *env = this; env; env = env->parent.get()) {
 		if (auto it = env->variables.find(name); it != env->variables.end()) {
 			return &it->second;
 		}
+		if (env->layout) {
+			if (auto slot = env->layout->slot(name); slot && env->slots[*slot]) {
+				return &*env->slots[*slot];
+			}
+		}
 	}
 	return nullptr;
 }
 
-std::shared_ptr<Env> Env::enter()
+Value* Env::find(Lexical_Address const& address, Symbol name)
+{
+	if (address.frame) {
+		for (Env *env = this; env; env = env->parent.get()) {
+			if (env->layout == address.frame) {
+				if (auto &slot = env->slots[address.slot]) {
+					return &*slot;
+				}
+				break;
+			}
+
+			// Scopes in between may have the same name defined dynamically
+			if (!env->variables.empty() && env->variables.contains(name)) {
+				break;
+			}
+		}
+	}
+	return find(name);
+}
+
+std::shared_ptr<Env> Env::enter(Frame_Layout const* layout)
 {
 	auto next = make();
 	next->parent = shared_from_this();
+	if (layout) {
+		next->layout = layout;
+		next->slots.resize(layout->names.size());
+	}
 	return next;
 }
 
@@ -2,6 +2,7 @@
 #define MUSIQUE_ENV_HH
 
 #include <memory>
+#include <musique/parser/ast.hh>
 #include <unordered_map>
 #include <musique/value/value.hh>
 
@@ -15,24 +16,36 @@ struct Env : std::enable_shared_from_this<Env>
 	static std::shared_ptr<Env> global;
 
 	/// Variables in current scope
-	std::unordered_map<std::string, Value> variables;
+	std::unordered_map<Symbol, Value> variables;
 
 	/// Parent scope
 	std::shared_ptr<Env> parent;
 
+	/// Layout of frame when scope was created by calling lambda, see resolve()
+	Frame_Layout const* layout = nullptr;
+
+	/// Variables of frame described by layout, unset until defined
+	std::vector<std::optional<Value>> slots;
+
 	Env(Env const&) = delete;
 	Env(Env &&) = default;
 	Env& operator=(Env const&) = delete;
 	Env& operator=(Env &&) = default;
 
 	/// Defines new variable regardless of it's current existance
-	Env& force_define(std::string name, Value new_value);
+	Env& force_define(Symbol name, Value new_value);
+
+	/// Defines new variable in slot when address points into this frame, otherwise by name
+	Env& force_define(Lexical_Address const& address, Symbol name, Value new_value);
 
 	/// Finds variable in current or parent scopes
-	Value* find(std::string const& name);
+	Value* find(Symbol name);
+
+	/// Finds variable using its lexical address, falling back to name lookup
+	Value* find(Lexical_Address const& address, Symbol name);
 
-	/// Create new scope with self as parent
-	std::shared_ptr<Env> enter();
+	/// Create new scope with self as parent, with slots described by layout
+	std::shared_ptr<Env> enter(Frame_Layout const* layout = nullptr);
 
 	/// Leave current scope returning parent
 	std::shared_ptr<Env> leave();
@@ -7,10 +7,8 @@
 #include <iostream>
 #include <random>
 #include <thread>
-#include <condition_variable>
-#include <mutex>
 
-std::unordered_map<std::string, Intrinsic> Interpreter::operators {};
+std::unordered_map<Symbol, Intrinsic> Interpreter::operators {};
 
 /// Registers constants like `fn = full note = 1/1`
 static inline void register_note_length_constants()
@@ -75,7 +73,7 @@ Interpreter::~Interpreter()
 	Env::global.reset();
 }
 
-Result<Value> Interpreter::eval(Ast &&ast)
+Result<Value> Interpreter::eval(Ast const& ast, bool tail)
 {
 	handle_potential_interrupt();
 
@@ -85,19 +83,17 @@ Result<Value> Interpreter::eval(Ast &&ast)
 		case Token::Type::Symbol:
 			{
 				if (ast.token.source.starts_with('\'')) {
-					if (auto op = operators.find(std::string(ast.token.source.substr(1))); op != operators.end()) {
-						return Value(op->second);
+					if (ast.intrinsic) {
+						return Value(ast.intrinsic);
 					} else {
-						return std::move(ast.token.source).substr(1);
+						return Value(ast.symbol);
 					}
 				}
 
-				auto name = std::string(ast.token.source);
-
-				auto const value = env->find(name);
+				auto const value = env->find(ast.address, ast.symbol);
 				if (!value) {
 					return Error {
-						.details  = errors::Missing_Variable { .name = std::move(name) },
+						.details  = errors::Missing_Variable { .name = std::string(ast.token.source) },
 						.location = ast.location
 					};
 				}
@@ -113,9 +109,32 @@ Result<Value> Interpreter::eval(Ast &&ast)
 		{
 			ensure(ast.arguments.size() == 2, "Expected arguments of binary operation to be 2 long");
 
+			if (ast.compound_assignment) {
+				auto const& lhs = ast.arguments.front();
+				auto const& rhs = ast.arguments.back();
+				ensure(lhs.type == Ast::Type::Literal && lhs.token.type == Token::Type::Symbol,
+					"Currently LHS of assigment must be an identifier"); // TODO(assert)
+
+				Value *v = env->find(lhs.address, lhs.symbol);
+				ensure(v, "Cannot resolve variable: "s + std::string(lhs.token.source)); // TODO(assert)
+				return *v = Try(ast.intrinsic(*this, {
+					*v, Try(eval(rhs).with_location(rhs.location))
+				}).with_location(ast.token.location));
+			}
+
+			if (ast.intrinsic) {
+				std::vector<Value> values;
+				values.reserve(ast.arguments.size());
+				for (auto const& a : ast.arguments) {
+					values.push_back(Try(eval(a).with_location(a.location)));
+				}
+
+				return ast.intrinsic(*this, std::move(values)).with_location(ast.token.location);
+			}
+
 			if (ast.token.source == "=") {
-				auto lhs = std::move(ast.arguments.front());
-				auto rhs = std::move(ast.arguments.back());
+				auto const& lhs = ast.arguments.front();
+				auto const& rhs = ast.arguments.back();
 
 				if (lhs.type != Ast::Type::Literal || lhs.token.type != Token::Type::Symbol) {
 					return Error {
@@ -128,7 +147,7 @@ Result<Value> Interpreter::eval(Ast &&ast)
 					};
 				}
 
-				Value *v = env->find(std::string(lhs.token.source));
+				Value *v = env->find(lhs.address, lhs.symbol);
 				if (v == nullptr) {
 					return Error {
 						.details = errors::Missing_Variable {
@@ -137,71 +156,34 @@ Result<Value> Interpreter::eval(Ast &&ast)
 						.location = lhs.location,
 					};
 				}
-				return *v = Try(eval(std::move(rhs)).with_location(ast.token.location));
+				return *v = Try(eval(rhs).with_location(ast.token.location));
 			}
 
 			if (ast.token.source == "and" || ast.token.source == "or") {
-				auto lhs = std::move(ast.arguments.front());
-				auto rhs = std::move(ast.arguments.back());
+				auto const& lhs = ast.arguments.front();
+				auto const& rhs = ast.arguments.back();
 
-				auto lhs_loc = lhs.location, rhs_loc = rhs.location;
-
-				auto result = Try(eval(std::move(lhs)).with_location(std::move(lhs_loc)));
+				auto result = Try(eval(lhs).with_location(lhs.location));
 				if (ast.token.source == "or" ? result.truthy() : result.falsy()) {
 					return result;
 				} else {
-					return eval(std::move(rhs)).with_location(rhs_loc);
+					return eval(rhs, tail).with_location(rhs.location);
 				}
 			}
 
-			auto op = operators.find(std::string(ast.token.source));
-			if (op == operators.end()) {
-				if (ast.token.source.ends_with('=')) {
-					auto op = operators.find(std::string(ast.token.source.substr(0, ast.token.source.size()-1)));
-					if (op == operators.end()) {
-						return Error {
-							.details = errors::Undefined_Operator { .op = std::string(ast.token.source) },
-							.location = ast.token.location
-						};
-					}
-
-					auto lhs = std::move(ast.arguments.front());
-					auto rhs = std::move(ast.arguments.back());
-					auto const rhs_loc = rhs.location;
-					ensure(lhs.type == Ast::Type::Literal && lhs.token.type == Token::Type::Symbol,
-						"Currently LHS of assigment must be an identifier"); // TODO(assert)
-
-					Value *v = env->find(std::string(lhs.token.source));
-					ensure(v, "Cannot resolve variable: "s + std::string(lhs.token.source)); // TODO(assert)
-					return *v = Try(op->second(*this, {
-						*v, Try(eval(std::move(rhs)).with_location(rhs_loc))
-					}).with_location(ast.token.location));
-				}
-
-				return Error {
-					.details = errors::Undefined_Operator { .op = std::string(ast.token.source) },
-					.location = ast.token.location
-				};
-			}
-
-			std::vector<Value> values;
-			values.reserve(ast.arguments.size());
-			for (auto& a : ast.arguments) {
-				auto const a_loc = a.location;
-				values.push_back(Try(eval(std::move(a)).with_location(a_loc)));
-			}
-
-			return op->second(*this, std::move(values)).with_location(ast.token.location);
+			return Error {
+				.details = errors::Undefined_Operator { .op = std::string(ast.token.source) },
+				.location = ast.token.location
+			};
 		}
-		break;
 
 	case Ast::Type::Sequence:
 		{
 			Value v;
 			bool first = true;
-			for (auto &a : ast.arguments) {
+			for (auto const& a : ast.arguments) {
 				if (!first && default_action) Try(default_action(*this, v));
-				v = Try(eval(std::move(a)));
+				v = Try(eval(a, tail && &a == &ast.arguments.back()));
 				first = false;
 			}
 			return v;
@@ -209,20 +191,31 @@ Result<Value> Interpreter::eval(Ast &&ast)
 
 	case Ast::Type::Call:
 		{
-			auto call_location = ast.arguments.front().location;
-			Value func = Try(eval(std::move(ast.arguments.front())));
+			auto const& call_location = ast.arguments.front().location;
+			Value func = Try(eval(ast.arguments.front()));
 
 			if (auto macro = std::get_if<Macro>(&func.data)) {
+				macro_in_tail_position = tail;
 				return (*macro)(*this, std::span(ast.arguments).subspan(1));
 			}
 
 			std::vector<Value> values;
 			values.reserve(ast.arguments.size());
-			for (auto& a : std::span(ast.arguments).subspan(1)) {
-				values.push_back(Try(eval(std::move(a))));
+			for (auto const& a : std::span(ast.arguments).subspan(1)) {
+				values.push_back(Try(eval(a)));
+			}
+
+			if (tail && holds_alternative<Block>(func)) {
+				tail_call = Tail_Call {
+					.function = std::move(func),
+					.arguments = std::move(values),
+					.location = call_location,
+				};
+				return Value{};
 			}
+
 			return std::move(func)(*this, std::move(values))
-				.with_location(std::move(call_location));
+				.with_location(call_location);
 		}
 
 	case Ast::Type::Variable_Declaration:
@@ -230,27 +223,14 @@ Result<Value> Interpreter::eval(Ast &&ast)
 			ensure(ast.arguments.size() == 2, "Only simple assigments are supported now");
 			ensure(ast.arguments.front().type == Ast::Type::Literal, "Only names are supported as LHS arguments now");
 			ensure(ast.arguments.front().token.type == Token::Type::Symbol, "Only names are supported as LHS arguments now");
-			env->force_define(std::string(ast.arguments.front().token.source), Try(eval(std::move(ast.arguments.back()))));
+			auto const& lhs = ast.arguments.front();
+			env->force_define(lhs.address, lhs.symbol, Try(eval(ast.arguments.back())));
 			return Value{};
 		}
 
 	case Ast::Type::Block:
 	case Ast::Type::Lambda:
-		{
-			Block block;
-			if (ast.type == Ast::Type::Lambda) {
-				auto parameters = std::span<Ast>(ast.arguments.data(), ast.arguments.size() - 1);
-				block.parameters.reserve(parameters.size());
-				for (auto &param : parameters) {
-					ensure(param.type == Ast::Type::Literal && param.token.type == Token::Type::Symbol, "Not a name in parameter section of Ast::lambda");
-					block.parameters.push_back(std::string(std::move(param).token.source));
-				}
-			}
-
-			block.context = env;
-			block.body = std::move(ast.arguments.back());
-			return block;
-		}
+		return Block::from(tree, ast, env);
 	}
 
 	std::cout << ast.type << std::endl;
@@ -258,6 +238,14 @@ Result<Value> Interpreter::eval(Ast &&ast)
 	unreachable();
 }
 
+Result<Value> Interpreter::eval(std::shared_ptr<Ast const> const& tree, Ast const& ast, bool tail)
+{
+	auto previous = std::exchange(this->tree, tree);
+	auto result = eval(ast, tail);
+	this->tree = std::move(previous);
+	return result;
+}
+
 void Interpreter::enter_scope()
 {
 	env = env->enter();
@@ -277,38 +265,34 @@ std::optional<Error> Interpreter::play(Chord chord)
 	handle_potential_interrupt();
 
 	if (chord.notes.size() == 0) {
-		sleep(ctx.length_to_duration(ctx.length));
+		schedule(ctx.length_to_duration(ctx.length));
+		wait_for_playback();
 		return {};
 	}
 
 	// Fill all notes that don't have octave or length with defaults
-	std::transform(chord.notes.begin(), chord.notes.end(), chord.notes.begin(), [&](Note note) { return ctx.fill(note); });
+	ctx.fill(chord);
 
 	// Sort that we have smaller times first
 	std::sort(chord.notes.begin(), chord.notes.end(), [](Note const& lhs, Note const& rhs) { return lhs.length < rhs.length; });
 
-	Number max_time = *chord.notes.back().length;
+	auto const start = schedule(ctx.length_to_duration(*chord.notes.back().length));
 
 	// Turn all notes on
 	for (auto const& note : chord.notes) {
 		if (note.base) {
-			current_context->port->send_note_on(0, *note.into_midi_note(), 127);
-			active_notes.emplace(0, *note.into_midi_note());
+			send({ midi::Message::Type::Note_On, 0, *note.into_midi_note(), 127 }, start);
 		}
 	}
 
 	// Turn off each note at right time
 	for (auto const& note : chord.notes) {
-		if (max_time != Number(0)) {
-			max_time -= *note.length;
-			sleep(ctx.length_to_duration(*note.length));
-		}
 		if (note.base) {
-			current_context->port->send_note_off(0, *note.into_midi_note(), 127);
-			active_notes.erase(active_notes.lower_bound(std::pair<unsigned, unsigned>{0, *note.into_midi_note()}));
+			send({ midi::Message::Type::Note_Off, 0, *note.into_midi_note(), 127 }, start + ctx.length_to_duration(*note.length));
 		}
 	}
 
+	wait_for_playback();
 	return {};
 }
 
@@ -319,17 +303,22 @@ void Interpreter::turn_off_all_active_notes()
 		return;
 	}
 
-	// TODO send to port that send_note_on was called on
-	for (auto [chan, note] : active_notes) {
-		current_context->port->send_note_off(chan, note, 0);
-	}
+	output.cancel();
 
-	active_notes.clear();
+	// Each note is turned off right away at the port it was turned on at, since music that would turn it off was cancelled
+	output.voices.turn_off_all([this, when = now()](std::shared_ptr<midi::Connection> const& port, midi::Message message) {
+		deliver(port, message, when);
+	});
 }
 
 
 std::optional<Error> ensure_midi_connection_available(Interpreter &interpreter, std::string_view operation_name)
 {
+	// Virtual clock records messages, so they can be inspected even without any port to send them to
+	if (interpreter.clock->is_virtual() && interpreter.current_context->port == nullptr) {
+		return {};
+	}
+
 	if (interpreter.current_context->port == nullptr || !interpreter.current_context->port->supports_output()) {
 		return Error {
 			.details = errors::Operation_Requires_Midi_Connection {
@@ -405,12 +394,13 @@ static void snapshot(std::ostream &out, Ast const& ast) {
 }
 
 static void snapshot(std::ostream& out, Value const& value) {
-	std::visit(Overloaded{
+	visit_unboxed(Overloaded{
 		[&](Nil) { out << "nil"; },
 		[&](Bool const& b) {
 			out << (b ? "true" : "false");
 		},
-		[&](Number const& n) {
+		[&](Number const& number) {
+			auto const n = number.simplify();
 			out << "(" << n.num << "/" << n.den << ")";
 		},
 		[&](Array const& array) {
@@ -443,7 +433,7 @@ static void snapshot(std::ostream& out, Value const& value) {
 				out << param << ' ';
 			}
 			out << "| ";
-			snapshot(out, block.body);
+			snapshot(out, *block.body);
 			out << ")";
 		},
 		[](Intrinsic const&) { unreachable(); },
@@ -455,17 +445,27 @@ void Interpreter::snapshot(std::ostream& out)
 {
 	auto const& ctx = *current_context;
 	out << ", oct " << int(ctx.octave) << '\n';
-	out << ", len (" << ctx.length.num << "/" << ctx.length.den << ")\n";
+	auto const length = ctx.length.simplify();
+	out << ", len (" << length.num << "/" << length.den << ")\n";
 	out << ", bpm " << ctx.bpm << '\n';
 
+	auto const snapshot_variable = [&](Symbol name, Value const& value) {
+		if (std::holds_alternative<Intrinsic>(value.data) || std::holds_alternative<Macro>(value.data)) {
+			return;
+		}
+		out << ", " << name << " := ";
+		::snapshot(out, value);
+		out << '\n';
+	};
+
 	for (auto current = env.get(); current; current = current->parent.get()) {
 		for (auto const& [name, value] : current->variables) {
-			if (std::holds_alternative<Intrinsic>(value.data) || std::holds_alternative<Macro>(value.data)) {
-				continue;
+			snapshot_variable(name, value);
+		}
+		for (auto slot = 0u; slot < current->slots.size(); ++slot) {
+			if (current->slots[slot]) {
+				snapshot_variable(current->layout->names[slot], *current->slots[slot]);
 			}
-			out << ", " << name << " := ";
-			::snapshot(out, value);
-			out << '\n';
 		}
 	}
 	out << std::flush;
@@ -473,8 +473,6 @@ void Interpreter::snapshot(std::ostream& out)
 
 // TODO This only supports single-threaded interpreter execution
 static std::atomic<bool> interrupted = false;
-static std::condition_variable condvar;
-static std::mutex mu;
 
 void Interpreter::handle_potential_interrupt()
 {
@@ -487,14 +485,216 @@ void Interpreter::handle_potential_interrupt()
 void Interpreter::issue_interrupt()
 {
 	interrupted = true;
-	condvar.notify_all();
+	clock->interrupt();
+	if (input) {
+		input->interrupt();
+	}
 }
 
-void Interpreter::sleep(std::chrono::duration<float> time)
+void Interpreter::send(midi::Message message, std::optional<std::chrono::steady_clock::time_point> when)
 {
-	if (std::unique_lock lock(mu); condvar.wait_for(lock, time) == std::cv_status::no_timeout) {
-		ensure(interrupted, "Only interruption can result in quiting conditional variable without timeout");
-		interrupted = false;
-		throw KeyboardInterrupt{};
+	auto const& port = current_context->port;
+	auto const time = when ? *when : playback_position();
+	send(port, message, time, std::exchange(unanswered_input, std::nullopt));
+}
+
+void Interpreter::send(std::shared_ptr<midi::Connection> const& port, midi::Message message, std::chrono::steady_clock::time_point time,
+	std::optional<std::chrono::steady_clock::time_point> answers)
+{
+	if (track_output) {
+		track_output->push_back({ .when = time, .port = port, .message = message, .answers = answers });
+		return;
+	}
+	deliver(port, message, time, answers);
+}
+
+void Interpreter::deliver(std::shared_ptr<midi::Connection> const& port, midi::Message message, std::chrono::steady_clock::time_point time,
+	std::optional<std::chrono::steady_clock::time_point> answers)
+{
+	// Virtual clock delivers messages immediately, so they are counted as sent right away
+	if (clock->is_virtual()) {
+		if (answers) {
+			output.add_latency(std::max(time, now()) - *answers);
+		}
+		clock->record(time, message);
+		midi::Voices::sent(output.voices.table_of(port), message);
+		if (port) {
+			port->set_time(time);
+			message.send(*port);
+		}
+		return;
 	}
+
+	// Wait for output thread to make room in its queue, staying responsive to interrupts
+	while (output.pending() >= midi::Output_Thread::Capacity) {
+		sleep_until(now() + std::chrono::milliseconds(1));
+	}
+	output.schedule(port, message, clock->real_time(time), answers);
 }
+
+std::optional<midi::Received_Message> Interpreter::receive(std::optional<std::chrono::steady_clock::time_point> deadline)
+{
+	ensure(input != nullptr, "receive requires chosen input");
+	for (;;) {
+		handle_potential_interrupt();
+		if (auto received = input->poll(now())) {
+			unanswered_input = received->when;
+			return received;
+		}
+		if (input->exhausted() || (deadline && now() >= *deadline)) {
+			return std::nullopt;
+		}
+
+		auto const until = deadline.value_or(std::chrono::steady_clock::time_point::max());
+		if (auto const next = input->next_arrival()) {
+			sleep_until(std::min(*next, until));
+		} else {
+			// Wait in short slices, so time point doesn't overflow and wake up missed by interrupt is noticed soon
+			input->wait_until(std::min(until, now() + std::chrono::milliseconds(100)));
+		}
+	}
+}
+
+
+std::chrono::steady_clock::time_point Interpreter::now() const
+{
+	return clock->now();
+}
+
+std::chrono::steady_clock::time_point Interpreter::playback_position() const
+{
+	auto const now = this->now();
+	return playback_time ? std::max(*playback_time, now) : now;
+}
+
+void Interpreter::wait_for_playback()
+{
+	if (playback_time && !track_output) {
+		sleep_until(*playback_time - current_context->length_to_duration(current_context->lookahead));
+	}
+}
+
+std::chrono::steady_clock::time_point Interpreter::schedule(std::chrono::steady_clock::duration length)
+{
+	auto const now = this->now();
+	if (playback_time && *playback_time < now && current_context->lookahead != Number(0)) {
+		++lookahead_underruns;
+	}
+	if (!playback_time || *playback_time + length < now) {
+		playback_time = now;
+	}
+	return std::exchange(*playback_time, *playback_time + length);
+}
+
+void Interpreter::sleep_until(std::chrono::steady_clock::time_point time)
+{
+	handle_potential_interrupt();
+	while (!clock->sleep_until(time)) {
+		// Interrupt may have been already handled by check above, then sleeping continues
+		handle_potential_interrupt();
+	}
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+#include <musique/parser/parser.hh>
+
+TEST_CASE("Scheduling playback", "[interpreter]")
+{
+	using namespace std::chrono_literals;
+	Interpreter interpreter;
+
+	auto const before = std::chrono::steady_clock::now();
+	auto const first = interpreter.schedule(1s);
+	REQUIRE(first >= before);
+	REQUIRE(interpreter.playback_time == first + 1s);
+
+	// Music that is late but can still be played continues where previous one ended
+	auto const late = std::chrono::steady_clock::now() - 10ms;
+	interpreter.playback_time = late;
+	REQUIRE(interpreter.schedule(1s) == late);
+	REQUIRE(interpreter.playback_time == late + 1s);
+
+	// Music that would have already ended starts now
+	interpreter.playback_time = std::chrono::steady_clock::now() - 10s;
+	auto const resynchronized = interpreter.schedule(1s);
+	REQUIRE(resynchronized > late);
+	REQUIRE(interpreter.playback_time == resynchronized + 1s);
+}
+
+TEST_CASE("Counting lookahead underruns", "[interpreter]")
+{
+	using namespace std::chrono_literals;
+	Interpreter interpreter;
+
+	// Without lookahead music is always scheduled just in time
+	interpreter.playback_time = std::chrono::steady_clock::now() - 10ms;
+	interpreter.schedule(1s);
+	REQUIRE(interpreter.lookahead_underruns == 0);
+
+	interpreter.current_context->lookahead = Number(1, 4);
+	interpreter.schedule(1s);
+	REQUIRE(interpreter.lookahead_underruns == 0);
+
+	interpreter.playback_time = std::chrono::steady_clock::now() - 10ms;
+	interpreter.schedule(1s);
+	REQUIRE(interpreter.lookahead_underruns == 1);
+}
+
+TEST_CASE("Reading shared arrays doesn't copy them", "[interpreter]")
+{
+	Interpreter interpreter;
+
+	auto tree = *Parser::parse("xs := up 100, ys := xs, len xs, xs[3], xs[up 3], for xs (x | x + 1), map (x | x) xs, duration xs, ys", "test");
+	resolve(tree, Interpreter::operators);
+	auto const result = *interpreter.eval(tree);
+
+	auto const& xs = std::get<Box<Array>>(interpreter.env->find(Symbol("xs"))->data);
+	auto const& ys = std::get<Box<Array>>(interpreter.env->find(Symbol("ys"))->data);
+	REQUIRE(xs.shares_with(ys));
+	REQUIRE(xs.shares_with(std::get<Box<Array>>(result.data)));
+
+	// Updating one of them gives it its own storage, leaving the other one untouched
+	auto update = *Parser::parse("ys = update ys 0 1", "test");
+	resolve(update, Interpreter::operators);
+	REQUIRE(interpreter.eval(update).has_value());
+	REQUIRE(!xs.shares_with(ys));
+	REQUIRE(xs->elements.front() == Value(Number(0)));
+	REQUIRE(ys->elements.front() == Value(Number(1)));
+}
+
+TEST_CASE("Program trees are freed with their last block", "[interpreter]")
+{
+	Interpreter interpreter;
+
+	auto const parse = [](std::string_view source) {
+		auto tree = std::make_shared<Ast>(*Parser::parse(source, "test"));
+		resolve(*tree, Interpreter::operators);
+		return tree;
+	};
+
+	std::weak_ptr<Ast> definition, temporary;
+	{
+		auto tree = parse("inc := (x | x + 1)");
+		definition = tree;
+		REQUIRE(interpreter.eval(tree, *tree).has_value());
+	}
+	{
+		auto tree = parse("map (x | x * 2) (up 3)");
+		temporary = tree;
+		REQUIRE(interpreter.eval(tree, *tree).has_value());
+	}
+
+	// Block stored in variable keeps its tree, while tree of temporary block is gone
+	REQUIRE(!definition.expired());
+	REQUIRE(temporary.expired());
+
+	auto call = parse("inc 41");
+	REQUIRE(*interpreter.eval(call, *call) == Value(Number(42)));
+
+	interpreter.env->force_define(Symbol("inc"), Value{});
+	REQUIRE(definition.expired());
+}
+
+#endif
@@ -1,10 +1,14 @@
 #ifndef MUSIQUE_INTERPRETER_HH
 #define MUSIQUE_INTERPRETER_HH
 
+#include <musique/interpreter/clock.hh>
 #include <musique/interpreter/context.hh>
 #include <musique/interpreter/starter.hh>
+#include <musique/midi/input.hh>
 #include <musique/midi/midi.hh>
+#include <musique/midi/output_thread.hh>
 #include <musique/value/value.hh>
+#include <memory>
 #include <unordered_map>
 #include <set>
 #include <random>
@@ -15,11 +19,27 @@ struct KeyboardInterrupt : std::exception
 	char const* what() const noexcept override { return "KeyboardInterrupt"; }
 };
 
+/// Call of a block in tail position of other block body
+///
+/// It's not performed where it appears but by Block::operator() that evaluated the body,
+/// so recursion through such calls doesn't grow the stack.
+struct Tail_Call
+{
+	/// Called block
+	Value function;
+
+	/// Evaluated arguments
+	std::vector<Value> arguments;
+
+	/// Location assigned to errors of the call that don't have one
+	Location location;
+};
+
 /// Given program tree evaluates it into Value
 struct Interpreter
 {
 	/// Operators defined for language
-	static std::unordered_map<std::string, Intrinsic> operators;
+	static std::unordered_map<Symbol, Intrinsic> operators;
 
 	/// Current environment (current scope)
 	std::shared_ptr<Env> env;
@@ -30,19 +50,73 @@ struct Interpreter
 
 	std::function<std::optional<Error>(Interpreter&, Value)> default_action;
 
-	std::multiset<std::pair<unsigned, unsigned>> active_notes;
+	/// Thread that sends all MIDI messages, so computation doesn't delay them
+	midi::Output_Thread output;
 
 	Starter starter;
 
 	std::mt19937 random_number_engine;
 
+	/// Call left by evaluation in tail position, waiting to be performed by block that is currently called
+	std::optional<Tail_Call> tail_call;
+
+	/// Whether macro that is currently called was called in tail position, see eval()
+	bool macro_in_tail_position = false;
+
+	/// Owner of program tree that evaluated nodes belong to
+	///
+	/// Blocks created during evaluation share it, so each tree is freed once no block refers to it.
+	/// When empty, evaluated tree must outlive all blocks created from it.
+	std::shared_ptr<Ast const> tree;
+
+	/// Point in time when music played so far by current program ends
+	///
+	/// Notes are scheduled against it instead of sleeping for their length, so time spent
+	/// between them doesn't accumulate into drift from tempo. Reset before each program run.
+	std::optional<std::chrono::steady_clock::time_point> playback_time;
+
+	/// Source of time that music is scheduled against. Virtual clock doesn't wait,
+	/// so music is played as fast as it can be computed, like when rendering to files.
+	std::unique_ptr<Clock> clock = std::make_unique<Real_Time_Clock>();
+
+	/// How many times music was scheduled after it should have started, while lookahead was enabled
+	unsigned lookahead_underruns = 0;
+
+	/// Source of messages taken by `receive`, when input was chosen
+	std::shared_ptr<midi::Input> input;
+
+	/// Arrival time of last received message that wasn't responded to yet
+	std::optional<std::chrono::steady_clock::time_point> unanswered_input;
+
+	/// Message sent while evaluating track of `sim`, waiting to be merged with messages of other tracks
+	struct Track_Message
+	{
+		std::chrono::steady_clock::time_point when;
+		std::shared_ptr<midi::Connection> port;
+		midi::Message message;
+		std::optional<std::chrono::steady_clock::time_point> answers;
+	};
+
+	/// When present, tracks of `sim` are evaluated: messages are collected here instead of being sent
+	/// and waiting for playback returns immediately, since tracks are paced by their scheduler.
+	std::vector<Track_Message> *track_output = nullptr;
+
 	Interpreter();
 	~Interpreter();
 	Interpreter(Interpreter &&) = delete;
 	Interpreter(Interpreter const&) = delete;
 
-	/// Try to evaluate given program tree
-	Result<Value> eval(Ast &&ast);
+	/// Try to evaluate given node of current program tree
+	///
+	/// Tree is only read during evaluation, blocks created from it refer to their bodies
+	/// inside it and share ownership of it through `tree`.
+	///
+	/// When tree is evaluated in tail position of block body, calls of blocks in tail position
+	/// of the tree are not performed but left in tail_call for Block::operator().
+	Result<Value> eval(Ast const& ast, bool tail = false);
+
+	/// Try to evaluate given node of given program tree, making it current tree during evaluation
+	Result<Value> eval(std::shared_ptr<Ast const> const& tree, Ast const& ast, bool tail = false);
 
 	// Enter scope by changing current environment
 	void enter_scope();
@@ -67,6 +141,8 @@ struct Interpreter
 	void snapshot(std::ostream& out);
 
 	/// Turn all notes that have been played but don't finished playing
+	///
+	/// Cancels scheduled music and turns notes off right away at ports they were turned on at.
 	void turn_off_all_active_notes();
 
 	/// Handles interrupt if any occured
@@ -75,8 +151,40 @@ struct Interpreter
 	/// Issue new interrupt
 	void issue_interrupt();
 
-	/// Sleep for at least given time or until interrupt
-	void sleep(std::chrono::duration<float>);
+	/// Send message to current port at given point in time, by default at current playback position
+	void send(midi::Message message, std::optional<std::chrono::steady_clock::time_point> when = std::nullopt);
+
+	/// Send message to given port at given point in time
+	///
+	/// Used for messages that already have their port, like ones collected from tracks of `sim`.
+	/// When message answers received one, its arrival time is given, so latency is measured when message is sent.
+	void send(std::shared_ptr<midi::Connection> const& port, midi::Message message, std::chrono::steady_clock::time_point when,
+		std::optional<std::chrono::steady_clock::time_point> answers = std::nullopt);
+
+	/// Deliver message to port at given point in time: record it with virtual clock or schedule it to output thread
+	void deliver(std::shared_ptr<midi::Connection> const& port, midi::Message message, std::chrono::steady_clock::time_point when,
+		std::optional<std::chrono::steady_clock::time_point> answers = std::nullopt);
+
+	/// Take oldest received message, waiting for it until given time or until it arrives
+	std::optional<midi::Received_Message> receive(std::optional<std::chrono::steady_clock::time_point> deadline);
+
+	/// Current time of interpreter clock
+	std::chrono::steady_clock::time_point now() const;
+
+	/// Point in time that music played next would start at, never earlier than now
+	std::chrono::steady_clock::time_point playback_position() const;
+
+	/// Wait until music scheduled so far ends, or until it's within lookahead window of current time
+	void wait_for_playback();
+
+	/// Start music of given length at the end of music played so far
+	///
+	/// When it would have ended already, playback is synchronized with current time instead.
+	/// Returns point in time when the music starts.
+	std::chrono::steady_clock::time_point schedule(std::chrono::steady_clock::duration length);
+
+	/// Sleep until given point in time or until interrupt
+	void sleep_until(std::chrono::steady_clock::time_point);
 };
 
 std::optional<Error> ensure_midi_connection_available(Interpreter&, std::string_view operation_name);
@@ -2,15 +2,48 @@
 #include <musique/errors.hh>
 #include <musique/interpreter/starter.hh>
 
-struct Starter::Implementation
+#include <cmath>
+#include <utility>
+
+struct Starter::Implementation : Link_Session
 {
 	ableton::Link link = {30};
 
+	/// Number of starts that didn't end yet
+	unsigned active = 0;
+
+	/// Whether session playback was started by this instance
+	bool started_playing = false;
+
 	Implementation()
 	{
 		link.enable(true);
 		link.enableStartStopSync(true);
 	}
+
+	/// Convert time of Link clock into steady clock time
+	///
+	/// Link uses its own clock (CLOCK_MONOTONIC_RAW on Linux), so offset between them is measured on each conversion
+	std::chrono::steady_clock::time_point to_steady(std::chrono::microseconds link_time) const
+	{
+		return std::chrono::steady_clock::now() + (link_time - link.clock().micros());
+	}
+
+	/// Convert steady clock time into time of Link clock
+	std::chrono::microseconds to_link(std::chrono::steady_clock::time_point time) const
+	{
+		return link.clock().micros() + std::chrono::duration_cast<std::chrono::microseconds>(time - std::chrono::steady_clock::now());
+	}
+
+	double beat_at(std::chrono::steady_clock::time_point time) const override
+	{
+		return link.captureAppSessionState().beatAtTime(to_link(time), Quantum);
+	}
+
+	std::chrono::steady_clock::time_point time_at(double beat) const override
+	{
+		return to_steady(link.captureAppSessionState().timeAtBeat(beat, Quantum));
+	}
 };
 
 Starter::Starter()
@@ -18,61 +51,30 @@ Starter::Starter()
 {
 }
 
-struct State
-{
-	ableton::Link *link;
-	std::mutex mutex;
-	std::condition_variable condition;
-	std::atomic<bool> stop = false;
-};
-
-void Starter::start()
+std::unique_ptr<Link_Timeline> Starter::start(unsigned bpm)
 {
 	ensure(impl != nullptr, "Starter wasn't initialized properly");
 	auto &link = impl->link;
 
-	auto const quantum = 4;
-
-	auto const sessionState = link.captureAppSessionState();
-
-	// If we already started continue
-	if (sessionState.isPlaying()) {
-		return;
+	// Alone we lead session tempo, with peers we follow theirs
+	if (link.numPeers() == 0) {
+		auto session = link.captureAppSessionState();
+		session.setTempo(bpm, link.clock().micros());
+		link.commitAppSessionState(session);
 	}
 
-	auto state = std::make_shared<State>();
-	state->link = &link;
+	auto timeline = std::make_unique<Link_Timeline>(impl, std::chrono::steady_clock::now(), bpm);
+	++impl->active;
 
-	link.setStartStopCallback([state = state](bool is_playing)
-	{
-		if (is_playing) {
-			state->condition.notify_all();
-			state->stop = true;
-		}
-	});
-
-	std::thread starter([quantum = quantum, state = state]
-	{
-		auto counter = 0;
-		while (!state->stop) {
-			auto const time = state->link->clock().micros();
-			auto sessionState = state->link->captureAppSessionState();
-			if (counter == 2) {
-				sessionState.setIsPlaying(true, time);
-				state->link->commitAppSessionState(sessionState);
-				state->condition.notify_all();
-				state->stop = true;
-				return;
-			}
-			auto const phase = sessionState.phaseAtTime(time, quantum);
-			counter += phase == 0;
-		}
-	});
-	starter.detach();
+	// If peers already started we join them, otherwise playback starts for everyone at the same bar
+	auto session = link.captureAppSessionState();
+	if (!session.isPlaying()) {
+		session.setIsPlaying(true, impl->to_link(timeline->origin));
+		link.commitAppSessionState(session);
+		impl->started_playing = true;
+	}
 
-	// TODO Rejection via CTRL-C while waiting
-	std::unique_lock lock(state->mutex);
-	state->condition.wait(lock);
+	return timeline;
 }
 
 void Starter::stop()
@@ -80,10 +82,13 @@ void Starter::stop()
 	ensure(impl != nullptr, "Starter wasn't initialized properly");
 	auto &link = impl->link;
 
-	auto const time = link.clock().micros();
-	auto sessionState = link.captureAppSessionState();
-	sessionState.setIsPlaying(false, time);
-	link.commitAppSessionState(sessionState);
+	if (impl->active == 0 || --impl->active > 0 || !std::exchange(impl->started_playing, false)) {
+		return;
+	}
+
+	auto session = link.captureAppSessionState();
+	session.setIsPlaying(false, link.clock().micros());
+	link.commitAppSessionState(session);
 }
 
 size_t Starter::peers() const
@@ -93,3 +98,119 @@ size_t Starter::peers() const
 
 	return link.numPeers();
 }
+
+Link_Timeline::Link_Timeline(std::shared_ptr<Link_Session const> session, std::chrono::steady_clock::time_point after, double bpm)
+	: bpm(bpm), session(std::move(session))
+{
+	// Start at next bar, or right at given time when it is exactly at its beginning
+	origin_beat = std::ceil(this->session->beat_at(after) / Starter::Quantum) * Starter::Quantum;
+	origin = this->session->time_at(origin_beat);
+}
+
+std::chrono::steady_clock::time_point Link_Timeline::now() const
+{
+	auto const beat = session->beat_at(std::chrono::steady_clock::now());
+	auto const since_origin = std::chrono::duration<double>((beat - origin_beat) * 60 / bpm);
+	return origin + std::chrono::duration_cast<std::chrono::steady_clock::duration>(since_origin);
+}
+
+std::chrono::steady_clock::time_point Link_Timeline::real_time(std::chrono::steady_clock::time_point time) const
+{
+	auto const beat = origin_beat + std::chrono::duration<double>(time - origin).count() * bpm / 60;
+	return session->time_at(beat);
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+
+TEST_CASE("Link timeline follows session beats", "[interpreter]")
+{
+	using namespace std::chrono_literals;
+
+	/// Session of fixed tempo that reaches beat 0 at given point in time, standing in for live Link session
+	struct Fixed_Session : Link_Session
+	{
+		std::chrono::steady_clock::time_point zero;
+		double tempo;
+
+		Fixed_Session(std::chrono::steady_clock::time_point zero, double tempo)
+			: zero(zero), tempo(tempo)
+		{
+		}
+
+		double beat_at(std::chrono::steady_clock::time_point time) const override
+		{
+			return std::chrono::duration<double>(time - zero).count() * tempo / 60;
+		}
+
+		std::chrono::steady_clock::time_point time_at(double beat) const override
+		{
+			return zero + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(beat * 60 / tempo));
+		}
+	};
+
+	auto const close = [](auto time, auto expected) { return time > expected - 1us && time < expected + 1us; };
+	auto const zero = std::chrono::steady_clock::now();
+	auto const session = std::make_shared<Fixed_Session>(zero, 120);
+
+	SECTION("Origin is quantised to next bar") {
+		Link_Timeline timeline(session, zero + 2650ms, 60);
+		REQUIRE(timeline.origin_beat == 8);
+		REQUIRE(close(timeline.origin, zero + 4s));
+	}
+
+	SECTION("Origin at the beginning of bar stays there") {
+		Link_Timeline timeline(session, zero + 2s, 60);
+		REQUIRE(timeline.origin_beat == 4);
+		REQUIRE(close(timeline.origin, zero + 2s));
+	}
+
+	SECTION("Time is counted in own bpm and played in session beats") {
+		// Session plays twice as fast as timeline counts, so each second of timeline takes half a second
+		Link_Timeline timeline(session, zero + 100ms, 60);
+		REQUIRE(close(timeline.real_time(timeline.origin), timeline.origin));
+		REQUIRE(close(timeline.real_time(timeline.origin + 2s), timeline.origin + 1s));
+
+		auto const before = std::chrono::steady_clock::now();
+		auto const now = timeline.now();
+		auto const after = std::chrono::steady_clock::now();
+		REQUIRE(now >= timeline.origin + 2 * (before - timeline.origin) - 1us);
+		REQUIRE(now <= timeline.origin + 2 * (after - timeline.origin) + 1us);
+	}
+
+	SECTION("Changes of session tempo are followed") {
+		Link_Timeline timeline(session, zero, 120);
+		REQUIRE(close(timeline.real_time(timeline.origin + 2s), zero + 2s));
+
+		session->tempo = 60;
+		REQUIRE(close(timeline.real_time(timeline.origin + 2s), zero + 4s));
+	}
+}
+
+// Hidden, since it joins real Link session on local network, whose peers and timing it can't control.
+// Run it explicitly with `[link]` tag on machine without other Link applications.
+TEST_CASE("Starter plays with Link session", "[.][link]")
+{
+	using namespace std::chrono_literals;
+
+	Starter starter;
+	REQUIRE(starter.peers() == 0);
+
+	auto const before = std::chrono::steady_clock::now();
+	auto const timeline = starter.start(240);
+
+	// Start waits at most one bar, which takes one second in 240 bpm
+	REQUIRE(timeline->origin >= before - 1ms);
+	REQUIRE(timeline->origin <= before + 1s + 1ms);
+	REQUIRE(std::fmod(timeline->origin_beat, Starter::Quantum) == 0);
+
+	auto const close = [](auto duration, auto expected) { return duration > expected - 1ms && duration < expected + 1ms; };
+	REQUIRE(close(timeline->real_time(timeline->origin) - timeline->origin, 0s));
+	REQUIRE(close(timeline->real_time(timeline->origin + 2s) - timeline->real_time(timeline->origin), 2s));
+	REQUIRE(close(timeline->now() - std::chrono::steady_clock::now(), 0s));
+
+	starter.stop();
+}
+
+#endif
@@ -1,12 +1,41 @@
 #ifndef MUSIQUE_STARTER_HH
 #define MUSIQUE_STARTER_HH
 
+#include <chrono>
 #include <memory>
+#include <musique/interpreter/clock.hh>
+
+struct Link_Timeline;
+
+/// Beats of Ableton Link session, mapped to real time
+struct Link_Session
+{
+	virtual ~Link_Session() = default;
+
+	/// Session beat at given point in real time
+	virtual double beat_at(std::chrono::steady_clock::time_point time) const = 0;
+
+	/// Point in real time at which session reaches given beat
+	virtual std::chrono::steady_clock::time_point time_at(double beat) const = 0;
+};
 
 struct Starter
 {
+	/// Length of bar in beats, that playback starts are aligned to
+	static constexpr double Quantum = 4;
+
 	Starter();
-	void start();
+
+	/// Start playback with connected instances at next bar of Link session
+	///
+	/// Returns timeline following session beats from that bar, which counts given bpm as session tempo.
+	/// When there are no peers session tempo is set to given bpm, otherwise it follows peers.
+	std::unique_ptr<Link_Timeline> start(unsigned bpm);
+
+	/// End playback begun by matching call to start
+	///
+	/// Playback of session is stopped only when this instance started it and all its starts ended,
+	/// so peers that were playing before are left playing.
 	void stop();
 
 	size_t peers() const;
@@ -15,5 +44,31 @@ struct Starter
 	std::shared_ptr<Implementation> impl;
 };
 
+/// Timeline following beats of Ableton Link session
+///
+/// Time of this timeline is counted in beats at fixed bpm from bar that playback started at.
+/// Each beat is mapped to time at which session reaches it, so changes of session tempo
+/// and adjustments made by peers are followed through whole piece, not only at its start.
+struct Link_Timeline : Timeline
+{
+	/// Point in time of first beat, in both timeline time and real time
+	std::chrono::steady_clock::time_point origin;
+
+	/// Session beat at origin, always at the beginning of bar
+	double origin_beat;
+
+	/// Tempo that timeline time is counted in
+	double bpm;
+
+	/// Timeline starting at first bar of session beginning at or after given point in real time
+	Link_Timeline(std::shared_ptr<Link_Session const> session, std::chrono::steady_clock::time_point after, double bpm);
+	~Link_Timeline() override = default;
+
+	std::chrono::steady_clock::time_point now() const override;
+	std::chrono::steady_clock::time_point real_time(std::chrono::steady_clock::time_point) const override;
+
+private:
+	std::shared_ptr<Link_Session const> session;
+};
 
 #endif // MUSIQUE_STARTER_HH
@@ -0,0 +1,209 @@
+#include <musique/interpreter/interpreter.hh>
+#include <musique/interpreter/track.hh>
+
+#include <algorithm>
+#include <queue>
+
+Track::Track(std::coroutine_handle<promise_type> handle)
+	: handle(handle)
+{
+}
+
+Track::Track(Track &&other)
+	: handle(std::exchange(other.handle, nullptr))
+{
+}
+
+Track::~Track()
+{
+	if (handle) {
+		handle.destroy();
+	}
+}
+
+bool Track::resume()
+{
+	handle.resume();
+	if (auto exception = std::exchange(handle.promise().exception, nullptr)) {
+		std::rethrow_exception(exception);
+	}
+	return !handle.done();
+}
+
+std::optional<Error> Track::error() const
+{
+	return handle.promise().error;
+}
+
+/// Play elements of value one after another, suspending after each of them
+///
+/// Collections are traversed through Collection::index, so elements of blocks are evaluated
+/// only when track reaches them.
+static Track walk(Interpreter &interpreter, Value music)
+{
+	// Values that are traversed, each with position of the next element to take from it
+	std::vector<std::pair<Value, unsigned>> stack;
+	stack.emplace_back(std::move(music), 0);
+
+	while (!stack.empty()) {
+		auto &[value, position] = stack.back();
+
+		if (auto chord = get_if<Chord>(value)) {
+			auto played = *chord;
+			stack.pop_back();
+			if (auto error = interpreter.play(std::move(played))) {
+				co_return error;
+			}
+			co_yield {};
+			continue;
+		}
+
+		if (auto collection = get_if<Collection>(value)) {
+			if (position < collection->size()) {
+				auto element = collection->index(interpreter, position++);
+				if (!element.has_value()) {
+					co_return std::move(element).error();
+				}
+				stack.emplace_back(*std::move(element), 0);
+			} else {
+				stack.pop_back();
+			}
+			continue;
+		}
+
+		// Code evaluated only for its side effects, like `play` or `say`
+		if (holds_alternative<Nil>(value)) {
+			stack.pop_back();
+			co_yield {};
+			continue;
+		}
+
+		co_return Error{errors::Unsupported_Types_For {
+			.type = errors::Unsupported_Types_For::Function,
+			.name = "sim",
+			.possibilities = {
+				"(music | array of music)+"
+			},
+		}};
+	}
+
+	co_return std::nullopt;
+}
+
+std::optional<Error> play_simultaneously(Interpreter &interpreter, std::vector<Value> values)
+{
+	using Time_Point = std::chrono::steady_clock::time_point;
+
+	struct State
+	{
+		Track track;
+		std::shared_ptr<Context> context;
+		Time_Point cursor;
+	};
+
+	/// Message collected from track, tagged with track it came from
+	struct Collected
+	{
+		Interpreter::Track_Message sent;
+		unsigned track;
+	};
+
+	auto const& ctx = *interpreter.current_context;
+	auto const start = interpreter.schedule({});
+	auto const lookahead = ctx.length_to_duration(ctx.lookahead);
+
+	std::vector<State> states;
+	states.reserve(values.size());
+	for (auto &value : values) {
+		states.push_back(State {
+			.track = walk(interpreter, std::move(value)),
+			.context = std::make_shared<Context>(ctx),
+			.cursor = start,
+		});
+	}
+
+	// Interpreter state is swapped for the state of each resumed track, and restored even on interrupt
+	struct Restore
+	{
+		Interpreter &interpreter;
+		std::shared_ptr<Context> context = interpreter.current_context;
+		std::optional<Time_Point> playback_time = interpreter.playback_time;
+		std::vector<Interpreter::Track_Message> *track_output = interpreter.track_output;
+
+		~Restore()
+		{
+			interpreter.current_context = context;
+			interpreter.playback_time = playback_time;
+			interpreter.track_output = track_output;
+		}
+	} restore { interpreter };
+
+	// When this sim is itself a track of other sim, pacing is left to its scheduler
+	bool const nested = restore.track_output != nullptr;
+
+	std::vector<Interpreter::Track_Message> track_output;
+	std::vector<Collected> collected;
+
+	// Send collected messages earlier than given time in order of time, then of tracks
+	auto const flush = [&](std::optional<Time_Point> until) {
+		std::stable_sort(collected.begin(), collected.end(), [](Collected const& lhs, Collected const& rhs) {
+			return lhs.sent.when == rhs.sent.when ? lhs.track < rhs.track : lhs.sent.when < rhs.sent.when;
+		});
+		auto const end = until
+			? std::find_if(collected.begin(), collected.end(), [&](Collected const& c) { return c.sent.when >= *until; })
+			: collected.end();
+
+		interpreter.track_output = restore.track_output;
+		for (auto it = collected.begin(); it != end; ++it) {
+			interpreter.send(it->sent.port, it->sent.message, it->sent.when, it->sent.answers);
+		}
+		collected.erase(collected.begin(), end);
+	};
+
+	// Tracks that haven't ended, ordered by their musical time and then by track order
+	auto const later = [&](unsigned lhs, unsigned rhs) {
+		auto const& l = states[lhs].cursor;
+		auto const& r = states[rhs].cursor;
+		return l == r ? lhs > rhs : l > r;
+	};
+	std::priority_queue<unsigned, std::vector<unsigned>, decltype(later)> queue(later);
+	for (auto i = 0u; i < states.size(); ++i) {
+		queue.push(i);
+	}
+
+	auto end = start;
+	while (!queue.empty()) {
+		auto const i = queue.top();
+		queue.pop();
+		auto &state = states[i];
+
+		// Messages of other tracks that are earlier than this one are final now
+		flush(state.cursor);
+		if (!nested) {
+			interpreter.sleep_until(state.cursor - lookahead);
+		}
+
+		interpreter.current_context = state.context;
+		interpreter.playback_time = state.cursor;
+		interpreter.track_output = &track_output;
+
+		bool const running = state.track.resume();
+
+		state.cursor = interpreter.playback_time.value_or(state.cursor);
+		end = std::max(end, state.cursor);
+		for (auto &sent : track_output) {
+			collected.push_back({ .sent = std::move(sent), .track = i });
+		}
+		track_output.clear();
+
+		if (running) {
+			queue.push(i);
+		} else if (auto error = state.track.error()) {
+			return error;
+		}
+	}
+
+	flush(std::nullopt);
+	restore.playback_time = end;
+	return {};
+}
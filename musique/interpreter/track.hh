@@ -0,0 +1,54 @@
+#ifndef MUSIQUE_INTERPRETER_TRACK_HH
+#define MUSIQUE_INTERPRETER_TRACK_HH
+
+#include <coroutine>
+#include <exception>
+#include <musique/errors.hh>
+#include <musique/value/value.hh>
+#include <optional>
+#include <vector>
+
+struct Interpreter;
+
+/// Music of one `sim` argument, evaluated as coroutine suspended after each element it plays
+///
+/// Between suspensions track runs arbitrary code, so its side effects happen at its musical time.
+struct Track
+{
+	struct promise_type
+	{
+		std::optional<Error> error;
+		std::exception_ptr exception;
+
+		Track get_return_object() { return Track { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_always initial_suspend() { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		std::suspend_always yield_value(std::monostate) { return {}; }
+		void return_value(std::optional<Error> result) { error = std::move(result); }
+		void unhandled_exception() { exception = std::current_exception(); }
+	};
+
+	explicit Track(std::coroutine_handle<promise_type> handle);
+	Track(Track &&other);
+	Track(Track const&) = delete;
+	~Track();
+
+	/// Run track until it plays next element, returns false when it has ended
+	///
+	/// Exceptions thrown by the track are rethrown from here.
+	bool resume();
+
+	/// Error that ended track, if any
+	std::optional<Error> error() const;
+
+private:
+	std::coroutine_handle<promise_type> handle;
+};
+
+/// Play each value as separate track, all starting at current playback position
+///
+/// Tracks run on single thread, each with its own context. Scheduler always resumes one that
+/// is earliest in musical time, merging their messages in order of time.
+std::optional<Error> play_simultaneously(Interpreter &interpreter, std::vector<Value> values);
+
+#endif // MUSIQUE_INTERPRETER_TRACK_HH
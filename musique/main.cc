@@ -17,6 +17,7 @@
 #include <musique/user_directory.hh>
 #include <span>
 #include <thread>
+#include <unordered_map>
 #include <unordered_set>
 
 #include <replxx.hxx>
@@ -26,9 +27,12 @@ extern "C" {
 #include <io.h>
 }
 #else
+#include <sys/wait.h>
 #include <unistd.h>
 #endif
 
+extern std::optional<std::string> render_path;
+
 bool ast_only_mode = false;
 bool enable_repl = false;
 
@@ -210,30 +214,9 @@ void sigint_handler(int sig)
 	std::signal(SIGINT, sigint_handler);
 }
 
-/// Fancy main that supports Result forwarding on error (Try macro)
-[[maybe_unused]]
-static std::optional<Error> Main(std::span<char const*> args)
+/// Run code and files given in program arguments, in order
+static std::optional<Error> run_all(Runner &runner, std::span<ui::program_arguments::Run const> runnables)
 {
-	enable_repl = args.empty();
-
-	// TODO: is_tty should be in ui namespace
-	if (ui::program_arguments::is_tty() && getenv("NO_COLOR") == nullptr) {
-		pretty::terminal_mode();
-	}
-
-	std::vector<ui::program_arguments::Run> runnables;
-
-	while (args.size()) if (auto failed = ui::program_arguments::accept_commandline_argument(runnables, args)) {
-		std::cerr << pretty::begin_error << "musique: error:" << pretty::end;
-		std::cerr << " Failed to recognize parameter " << std::quoted(*failed) << std::endl;
-		ui::program_arguments::print_close_matches(args.front());
-		std::exit(1);
-	}
-
-	Runner runner;
-	::runner = &runner;
-	std::signal(SIGINT, sigint_handler);
-
 	for (auto const& [type, argument] : runnables) {
 		if (type == ui::program_arguments::Run::Argument) {
 			Lines::the.add_line("<arguments>", argument, repl_line_number);
@@ -262,6 +245,142 @@ static std::optional<Error> Main(std::span<char const*> args)
 		}
 	}
 
+	return {};
+}
+
+static bool is_file(ui::program_arguments::Run const& run)
+{
+	return run.type == ui::program_arguments::Run::File;
+}
+
+/// Render each file to its own MIDI file inside render_path directory, by parallel worker processes
+///
+/// Each worker runs code given in arguments before its file.
+static std::optional<Error> render_in_parallel(std::span<ui::program_arguments::Run const> runnables)
+{
+#ifdef _WIN32
+	(void)runnables;
+	std::cerr << pretty::begin_error << "musique: error:" << pretty::end;
+	std::cerr << " rendering multiple files at once is not supported on Windows" << std::endl;
+	std::exit(1);
+#else
+	auto const directory = std::filesystem::path(*render_path);
+	std::error_code error_code;
+	std::filesystem::create_directories(directory, error_code);
+
+	std::vector<ui::program_arguments::Run> prelude;
+	std::copy_if(runnables.begin(), runnables.end(), std::back_inserter(prelude),
+		[](ui::program_arguments::Run const& run) { return run.type == ui::program_arguments::Run::Argument; });
+
+	auto const max_workers = std::max(1u, std::thread::hardware_concurrency());
+	std::unordered_map<pid_t, std::string_view> workers;
+	bool failed = false;
+
+	auto const wait_for_worker = [&] {
+		int status = 0;
+		pid_t const pid = wait(&status);
+		if (pid < 0) {
+			workers.clear();
+			return;
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			std::cerr << pretty::begin_error << "musique: error:" << pretty::end;
+			std::cerr << " rendering of " << workers[pid] << " failed" << std::endl;
+			failed = true;
+		}
+		workers.erase(pid);
+	};
+
+	for (auto const& file : runnables) {
+		if (!is_file(file)) {
+			continue;
+		}
+		if (workers.size() >= max_workers) {
+			wait_for_worker();
+		}
+
+		std::cout << std::flush;
+		pid_t const pid = fork();
+		if (pid < 0) {
+			std::cerr << pretty::begin_error << "musique: error:" << pretty::end;
+			std::cerr << " couldn't start worker for " << file.argument << ": " << std::strerror(errno) << std::endl;
+			failed = true;
+			continue;
+		}
+
+		if (pid == 0) {
+			render_path = (directory / std::filesystem::path(file.argument).stem()).string() + ".mid";
+			auto job = prelude;
+			job.push_back(file);
+
+			int exit_code = 0;
+			{
+				Runner runner;
+				::runner = &runner;
+				std::signal(SIGINT, sigint_handler);
+
+				if (auto error = run_all(runner, job)) {
+					std::cerr << *error << std::flush;
+					exit_code = 1;
+				} else if (!runner.rendering->save(*render_path)) {
+					std::cerr << pretty::begin_error << "musique: error:" << pretty::end;
+					std::cerr << " couldn't write MIDI file: " << *render_path << std::endl;
+					exit_code = 1;
+				}
+			}
+			std::cout << std::flush;
+			std::_Exit(exit_code);
+		}
+		workers[pid] = file.argument;
+	}
+
+	while (!workers.empty()) {
+		wait_for_worker();
+	}
+
+	if (failed) {
+		std::exit(1);
+	}
+	return {};
+#endif
+}
+
+/// Fancy main that supports Result forwarding on error (Try macro)
+[[maybe_unused]]
+static std::optional<Error> Main(std::span<char const*> args)
+{
+	enable_repl = args.empty();
+
+	// TODO: is_tty should be in ui namespace
+	if (ui::program_arguments::is_tty() && getenv("NO_COLOR") == nullptr) {
+		pretty::terminal_mode();
+	}
+
+	std::vector<ui::program_arguments::Run> runnables;
+
+	while (args.size()) if (auto failed = ui::program_arguments::accept_commandline_argument(runnables, args)) {
+		std::cerr << pretty::begin_error << "musique: error:" << pretty::end;
+		std::cerr << " Failed to recognize parameter " << std::quoted(*failed) << std::endl;
+		ui::program_arguments::print_close_matches(args.front());
+		std::exit(1);
+	}
+
+	if (render_path && std::count_if(runnables.begin(), runnables.end(), is_file) > 1) {
+		return render_in_parallel(runnables);
+	}
+
+	Runner runner;
+	::runner = &runner;
+	std::signal(SIGINT, sigint_handler);
+
+	Try(run_all(runner, runnables));
+
+	if (runner.rendering && !runner.rendering->save(*render_path)) {
+		std::cerr << pretty::begin_error << "musique: error:" << pretty::end;
+		std::cerr << " couldn't write MIDI file: " << *render_path << std::endl;
+		std::exit(1);
+	}
+
 	enable_repl = enable_repl || (!runnables.empty() && std::all_of(runnables.begin(), runnables.end(),
 		[](ui::program_arguments::Run const& run) { return run.type == ui::program_arguments::Run::Deffered_File; }));
 
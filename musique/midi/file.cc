@@ -0,0 +1,145 @@
+#include <musique/midi/file.hh>
+
+#include <algorithm>
+#include <fstream>
+
+bool midi::File::supports_output() const
+{
+	return true;
+}
+
+void midi::File::send_note_on(uint8_t channel, uint8_t note_number, uint8_t velocity)
+{
+	record({ Message::Type::Note_On, channel, note_number, velocity });
+}
+
+void midi::File::send_note_off(uint8_t channel, uint8_t note_number, uint8_t velocity)
+{
+	record({ Message::Type::Note_Off, channel, note_number, velocity });
+}
+
+void midi::File::send_program_change(uint8_t channel, uint8_t program)
+{
+	record({ Message::Type::Program_Change, channel, program });
+}
+
+void midi::File::send_controller_change(uint8_t channel, uint8_t controller_number, uint8_t value)
+{
+	record({ Message::Type::Controller_Change, channel, controller_number, value });
+}
+
+void midi::File::set_time(std::chrono::steady_clock::time_point time)
+{
+	now = time;
+}
+
+void midi::File::record(Message message)
+{
+	events.push_back({ .when = now, .message = message });
+}
+
+/// Append number in variable length quantity format, 7 bits per byte with most significant first
+static void append_variable_length(std::vector<uint8_t> &bytes, uint32_t value)
+{
+	uint8_t encoded[5];
+	unsigned count = 0;
+	do {
+		encoded[count++] = value & 0x7f;
+		value >>= 7;
+	} while (value);
+
+	while (count--) {
+		bytes.push_back(encoded[count] | (count ? 0x80 : 0));
+	}
+}
+
+/// Append number as big endian integer of given size
+static void append_big_endian(std::vector<uint8_t> &bytes, uint32_t value, unsigned size)
+{
+	while (size--) {
+		bytes.push_back(value >> (8 * size));
+	}
+}
+
+std::vector<uint8_t> midi::File::encode() const
+{
+	using namespace std::chrono;
+
+	auto ordered = events;
+	std::stable_sort(ordered.begin(), ordered.end(), [](Event const& lhs, Event const& rhs) {
+		return lhs.when < rhs.when;
+	});
+
+	std::vector<uint8_t> track;
+
+	// Tempo of 500000 microseconds per quarter note (120 BPM)
+	track.insert(track.end(), { 0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20 });
+
+	uint64_t previous_tick = 0;
+	for (auto const& [when, message] : ordered) {
+		auto const since_start = std::max(duration_cast<nanoseconds>(when - start).count(), nanoseconds::rep(0));
+		auto const tick = (uint64_t(since_start) * 2 * Ticks_Per_Quarter_Note + 500'000'000) / 1'000'000'000;
+
+		append_variable_length(track, tick - previous_tick);
+		previous_tick = tick;
+
+		track.push_back(message.status());
+		track.push_back(message.first);
+		if (message.data_size() == 2) {
+			track.push_back(message.second);
+		}
+	}
+
+	// End of track
+	track.insert(track.end(), { 0x00, 0xff, 0x2f, 0x00 });
+
+	std::vector<uint8_t> file = { 'M', 'T', 'h', 'd' };
+	append_big_endian(file, 6, 4);
+	append_big_endian(file, 0, 2); // Single track format
+	append_big_endian(file, 1, 2); // Count of tracks
+	append_big_endian(file, Ticks_Per_Quarter_Note, 2);
+
+	file.insert(file.end(), { 'M', 'T', 'r', 'k' });
+	append_big_endian(file, track.size(), 4);
+	file.insert(file.end(), track.begin(), track.end());
+	return file;
+}
+
+bool midi::File::save(std::filesystem::path const& path) const
+{
+	auto const bytes = encode();
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+	return bool(out);
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+
+TEST_CASE("Encoding Standard MIDI File", "[midi]")
+{
+	using namespace std::chrono_literals;
+
+	midi::File file;
+	file.set_time(file.start + 500ms);
+	file.send_note_off(0, 60, 0);
+	file.set_time(file.start);
+	file.send_note_on(0, 60, 100);
+	file.set_time(file.start + 70s);
+	file.send_program_change(2, 5);
+
+	auto const bytes = file.encode();
+	auto const expected = std::vector<uint8_t> {
+		'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x03, 0xc0,
+		'M', 'T', 'r', 'k', 0, 0, 0, 25,
+		0x00, 0xff, 0x51, 0x03, 0x07, 0xa1, 0x20,
+		0x00,       0x90, 60, 100,
+		0x87, 0x40, 0x80, 60, 0,   // 960 ticks later
+		0x88, 0x92, 0x40, 0xc2, 5, // 69.5 seconds later, 133440 ticks
+		0x00, 0xff, 0x2f, 0x00,
+	};
+	REQUIRE(bytes == expected);
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MUSIQUE_MIDI_FILE_HH
+#define MUSIQUE_MIDI_FILE_HH
+
+#include <filesystem>
+#include <musique/midi/midi.hh>
+#include <vector>
+
+namespace midi
+{
+	/// Connection recording messages to be saved as Standard MIDI File
+	struct File : Connection
+	{
+		/// Ticks per quarter note of saved file. File tempo is 120 BPM, so tick is 1/1920 second
+		static constexpr unsigned Ticks_Per_Quarter_Note = 960;
+
+		/// Message together with the time it was sent at
+		struct Event
+		{
+			std::chrono::steady_clock::time_point when;
+			Message message;
+		};
+
+		/// Time that message times are counted from
+		std::chrono::steady_clock::time_point start = {};
+
+		/// Recorded messages, in order they were sent
+		std::vector<Event> events;
+
+		~File() override = default;
+
+		bool supports_output() const override;
+
+		void send_note_on (uint8_t channel, uint8_t note_number, uint8_t velocity) override;
+		void send_note_off(uint8_t channel, uint8_t note_number, uint8_t velocity) override;
+		void send_program_change(uint8_t channel, uint8_t program) override;
+		void send_controller_change(uint8_t channel, uint8_t controller_number, uint8_t value) override;
+
+		void set_time(std::chrono::steady_clock::time_point) override;
+
+		/// Encode recorded messages as single track Standard MIDI File, ordered by time
+		std::vector<uint8_t> encode() const;
+
+		/// Save encoded file at given path, returns false when it couldn't be written
+		bool save(std::filesystem::path const& path) const;
+
+	private:
+		void record(Message message);
+
+		std::chrono::steady_clock::time_point now = {};
+	};
+}
+
+#endif // MUSIQUE_MIDI_FILE_HH
@@ -0,0 +1,129 @@
+#include <musique/errors.hh>
+#include <musique/midi/input.hh>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+void midi::Rt_Midi_Input::connect_input()
+try {
+	ensure(not input.has_value(), "Reconeccting is not supported yet");
+	input.emplace();
+	input->setCallback(&Rt_Midi_Input::receive, this);
+	input->openVirtualPort("Musique");
+} catch (RtMidiError &error) {
+	// TODO(error)
+	std::cerr << "Failed to use MIDI connection: " << error.getMessage() << std::endl;
+	std::exit(33);
+}
+
+void midi::Rt_Midi_Input::connect_input(unsigned target)
+try {
+	ensure(not input.has_value(), "Reconeccting is not supported yet");
+	input.emplace();
+	input->setCallback(&Rt_Midi_Input::receive, this);
+	input->openPort(target);
+} catch (RtMidiError &error) {
+	// TODO(error)
+	std::cerr << "Failed to use MIDI connection: " << error.getMessage() << std::endl;
+	std::exit(33);
+}
+
+void midi::Rt_Midi_Input::receive(double, std::vector<unsigned char> *bytes, void *self)
+{
+	auto const when = std::chrono::steady_clock::now();
+	auto &input = *static_cast<Rt_Midi_Input*>(self);
+
+	auto const message = decode(*bytes);
+	if (!message) {
+		return;
+	}
+
+	if (!input.queue.push({ .when = when, .message = *message })) {
+		input.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	// Relay wakes waiting interpreter, so callback never locks mutex that interpreter holds
+	input.relay.signal();
+}
+
+std::optional<midi::Received_Message> midi::Rt_Midi_Input::poll(std::chrono::steady_clock::time_point)
+{
+	auto const received = queue.front();
+	if (received == nullptr) {
+		return std::nullopt;
+	}
+	auto const result = *received;
+	queue.pop();
+	return result;
+}
+
+void midi::Rt_Midi_Input::wait_until(std::chrono::steady_clock::time_point time)
+{
+	relay.listen();
+	std::unique_lock lock(mutex);
+	// Each arrival and interrupt advances relay, so wait ends on any of them
+	auto const seen = relay.signals();
+	arrived.wait_until(lock, time, [&] { return queue.size() > 0 || relay.signals() != seen; });
+}
+
+void midi::Rt_Midi_Input::interrupt()
+{
+	relay.signal();
+}
+
+bool midi::File_Input::load(std::filesystem::path const& path, std::chrono::steady_clock::time_point start)
+{
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+
+	messages.clear();
+	for (std::string line; std::getline(file, line);) {
+		if (line.empty()) {
+			continue;
+		}
+
+		std::istringstream is(line);
+		char at = 0;
+		double seconds = 0;
+		Message message {};
+		if (!(is >> at >> seconds >> message) || at != '@') {
+			return false;
+		}
+
+		auto const since_start = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+		messages.push_back({ .when = start + since_start, .message = message });
+	}
+
+	std::stable_sort(messages.begin(), messages.end(), [](Received_Message const& lhs, Received_Message const& rhs) {
+		return lhs.when < rhs.when;
+	});
+	std::reverse(messages.begin(), messages.end());
+	return true;
+}
+
+std::optional<midi::Received_Message> midi::File_Input::poll(std::chrono::steady_clock::time_point now)
+{
+	if (messages.empty() || messages.back().when > now) {
+		return std::nullopt;
+	}
+	auto const result = messages.back();
+	messages.pop_back();
+	return result;
+}
+
+std::optional<std::chrono::steady_clock::time_point> midi::File_Input::next_arrival() const
+{
+	if (messages.empty()) {
+		return std::nullopt;
+	}
+	return messages.back().when;
+}
+
+bool midi::File_Input::exhausted() const
+{
+	return messages.empty();
+}
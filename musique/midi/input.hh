@@ -0,0 +1,106 @@
+#ifndef MUSIQUE_MIDI_INPUT_HH
+#define MUSIQUE_MIDI_INPUT_HH
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <musique/midi/midi.hh>
+#include <musique/signal_relay.hh>
+#include <musique/spsc_queue.hh>
+#include <optional>
+#include <vector>
+
+namespace midi
+{
+	/// Message received from MIDI input together with the time it arrived at
+	struct Received_Message
+	{
+		std::chrono::steady_clock::time_point when;
+		Message message;
+	};
+
+	/// Source of MIDI messages coming from outside of the program
+	struct Input
+	{
+		virtual ~Input() = default;
+
+		/// Take oldest message that arrived not later than given time
+		virtual std::optional<Received_Message> poll(std::chrono::steady_clock::time_point now) = 0;
+
+		/// Time at which next message arrives, when it's known in advance
+		///
+		/// Inputs receiving messages from outside return nothing and can be waited for with wait_until.
+		virtual std::optional<std::chrono::steady_clock::time_point> next_arrival() const { return std::nullopt; }
+
+		/// Wait until message arrives, given time passes or wait is interrupted
+		virtual void wait_until(std::chrono::steady_clock::time_point) {}
+
+		/// Wake up caller of wait_until. Safe to call from signal handler
+		virtual void interrupt() {}
+
+		/// Whether no more messages will ever arrive
+		virtual bool exhausted() const { return false; }
+	};
+
+	/// Input receiving messages through RtMidi callback
+	///
+	/// Callback runs on RtMidi thread and only pushes timestamped messages into lock-free queue
+	/// and signals relay, so receiving never waits for the interpreter. Messages arriving when queue is full are dropped.
+	struct Rt_Midi_Input : Input
+	{
+		/// How many received messages can wait for the interpreter
+		static constexpr std::size_t Capacity = 1024;
+
+		~Rt_Midi_Input() override = default;
+
+		/// Create virtual MIDI input port
+		void connect_input();
+
+		/// Connect with specific MIDI port for receiving MIDI messages
+		void connect_input(unsigned target);
+
+		std::optional<Received_Message> poll(std::chrono::steady_clock::time_point now) override;
+		void wait_until(std::chrono::steady_clock::time_point) override;
+		void interrupt() override;
+
+		/// Count of messages dropped, because queue was full
+		std::atomic<unsigned> dropped = 0;
+
+		std::optional<RtMidiIn> input;
+
+	private:
+		static void receive(double delta_time, std::vector<unsigned char> *bytes, void *self);
+
+		Spsc_Queue<Received_Message, Capacity> queue;
+
+		/// Used only by waiting interpreter and its relay, messages themselves are passed through queue
+		std::mutex mutex;
+		std::condition_variable arrived;
+
+		/// Signalled on each received message and interrupt, so neither callback nor signal handler locks mutex
+		Signal_Relay relay{mutex, arrived};
+	};
+
+	/// Input replaying messages recorded in text file, in timeline format like `@0.500 note-on 0 60 127`
+	///
+	/// Messages arrive at their times counted from loading, following interpreter clock,
+	/// so with virtual clock input is repeatable. Used as stand-in for MIDI devices in tests.
+	struct File_Input : Input
+	{
+		/// Messages that didn't arrive yet, latest first
+		std::vector<Received_Message> messages;
+
+		~File_Input() override = default;
+
+		/// Load messages from given file with times counted from start, returns false when it couldn't be read or parsed
+		bool load(std::filesystem::path const& path, std::chrono::steady_clock::time_point start);
+
+		std::optional<Received_Message> poll(std::chrono::steady_clock::time_point now) override;
+		std::optional<std::chrono::steady_clock::time_point> next_arrival() const override;
+		bool exhausted() const override;
+	};
+}
+
+#endif // MUSIQUE_MIDI_INPUT_HH
@@ -1,5 +1,7 @@
+#include <musique/errors.hh>
 #include <musique/midi/midi.hh>
 
+#include <atomic>
 #include <concepts>
 #include <type_traits>
 
@@ -12,7 +14,196 @@ static constexpr auto u(Enum auto e)
 	return static_cast<std::underlying_type_t<decltype(e)>>(e);
 }
 
+/// Id given to next created connection, 0 is left for messages that aren't sent to any
+static std::atomic<unsigned> next_connection_id = 1;
+
+midi::Connection::Connection()
+	: id(next_connection_id++)
+{
+}
+
 void midi::Connection::send_all_sounds_off(uint8_t channel)
 {
 	send_controller_change(channel, u(Controller::All_Notes_Off), 0);
 }
+
+void midi::Connection::send_batch(std::span<Message const> messages)
+{
+	for (auto const& message : messages) {
+		message.send(*this);
+	}
+}
+
+void midi::Message::send(Connection &connection) const
+{
+	switch (type) {
+	break; case Type::Note_On:           connection.send_note_on(channel, first, second);
+	break; case Type::Note_Off:          connection.send_note_off(channel, first, second);
+	break; case Type::Program_Change:    connection.send_program_change(channel, first);
+	break; case Type::Controller_Change: connection.send_controller_change(channel, first, second);
+	}
+}
+
+uint8_t midi::Message::status() const
+{
+	switch (type) {
+	case Type::Note_On:           return 0b1001'0000 + channel;
+	case Type::Note_Off:          return 0b1000'0000 + channel;
+	case Type::Program_Change:    return 0b1100'0000 + channel;
+	case Type::Controller_Change: return 0b1011'0000 + channel;
+	}
+	unreachable();
+}
+
+unsigned midi::Message::data_size() const
+{
+	return type == Type::Program_Change ? 1 : 2;
+}
+
+std::ostream& midi::operator<<(std::ostream& os, Message const& message)
+{
+	switch (message.type) {
+	break; case Message::Type::Note_On:           os << "note-on";
+	break; case Message::Type::Note_Off:          os << "note-off";
+	break; case Message::Type::Program_Change:    os << "program-change";
+	break; case Message::Type::Controller_Change: os << "controller-change";
+	}
+	os << ' ' << unsigned(message.channel) << ' ' << unsigned(message.first);
+	if (message.data_size() == 2) {
+		os << ' ' << unsigned(message.second);
+	}
+	return os;
+}
+
+std::istream& midi::operator>>(std::istream& is, Message& message)
+{
+	std::string type;
+	unsigned channel = 0, first = 0, second = 0;
+	if (!(is >> type >> channel >> first)) {
+		return is;
+	}
+
+	if (type == "note-on")                message.type = Message::Type::Note_On;
+	else if (type == "note-off")          message.type = Message::Type::Note_Off;
+	else if (type == "program-change")    message.type = Message::Type::Program_Change;
+	else if (type == "controller-change") message.type = Message::Type::Controller_Change;
+	else {
+		is.setstate(std::ios::failbit);
+		return is;
+	}
+
+	if (message.data_size() == 2 && !(is >> second)) {
+		return is;
+	}
+
+	if (channel > 15 || first > 127 || second > 127) {
+		is.setstate(std::ios::failbit);
+		return is;
+	}
+
+	message.channel = channel;
+	message.first = first;
+	message.second = second;
+	return is;
+}
+
+std::optional<midi::Message> midi::decode(std::span<uint8_t const> bytes)
+{
+	if (bytes.empty()) {
+		return std::nullopt;
+	}
+
+	auto const status = bytes[0];
+	Message message {};
+	message.channel = status & 0x0f;
+	switch (status & 0xf0) {
+	break; case 0b1001'0000: message.type = Message::Type::Note_On;
+	break; case 0b1000'0000: message.type = Message::Type::Note_Off;
+	break; case 0b1100'0000: message.type = Message::Type::Program_Change;
+	break; case 0b1011'0000: message.type = Message::Type::Controller_Change;
+	break; default: return std::nullopt;
+	}
+
+	if (bytes.size() != 1 + message.data_size()) {
+		return std::nullopt;
+	}
+	message.first = bytes[1];
+	if (message.data_size() == 2) {
+		message.second = bytes[2];
+	}
+
+	if (message.type == Message::Type::Note_On && message.second == 0) {
+		message.type = Message::Type::Note_Off;
+	}
+	return message;
+}
+
+void midi::append_with_running_status(std::vector<uint8_t> &bytes, std::span<Message const> messages)
+{
+	std::optional<uint8_t> running_status;
+	for (auto const& message : messages) {
+		if (auto const status = message.status(); status != running_status) {
+			bytes.push_back(status);
+			running_status = status;
+		}
+		bytes.push_back(message.first);
+		if (message.data_size() == 2) {
+			bytes.push_back(message.second);
+		}
+	}
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <array>
+#include <catch_amalgamated.hpp>
+#include <sstream>
+
+TEST_CASE("Encoding messages with running status", "[midi]")
+{
+	using Type = midi::Message::Type;
+	auto const messages = std::array {
+		midi::Message { Type::Note_On,  0, 60, 127 },
+		midi::Message { Type::Note_On,  0, 64, 127 },
+		midi::Message { Type::Note_On,  1, 67, 127 },
+		midi::Message { Type::Program_Change, 1, 5 },
+		midi::Message { Type::Program_Change, 1, 6 },
+		midi::Message { Type::Note_On,  0, 72, 127 },
+	};
+
+	std::vector<uint8_t> bytes;
+	midi::append_with_running_status(bytes, messages);
+	REQUIRE(bytes == std::vector<uint8_t> {
+		0x90, 60, 127, 64, 127,
+		0x91, 67, 127,
+		0xc1, 5, 6,
+		0x90, 72, 127,
+	});
+}
+
+TEST_CASE("Decoding received messages", "[midi]")
+{
+	using Type = midi::Message::Type;
+	auto const decode = [](std::vector<uint8_t> bytes) { return midi::decode(bytes); };
+
+	REQUIRE(decode({ 0x93, 60, 100 }) == midi::Message { Type::Note_On,  3, 60, 100 });
+	REQUIRE(decode({ 0x90, 60, 0 })   == midi::Message { Type::Note_Off, 0, 60, 0 });
+	REQUIRE(decode({ 0xc1, 5 })       == midi::Message { Type::Program_Change, 1, 5 });
+	REQUIRE(decode({ 0xf8 })          == std::nullopt);
+	REQUIRE(decode({ 0x90, 60 })      == std::nullopt);
+}
+
+TEST_CASE("Reading printed messages", "[midi]")
+{
+	using Type = midi::Message::Type;
+	std::stringstream ss("note-on 3 60 100 program-change 1 5 note-of 0 1 2");
+
+	midi::Message message {};
+	REQUIRE(ss >> message);
+	REQUIRE(message == midi::Message { Type::Note_On, 3, 60, 100 });
+	REQUIRE(ss >> message);
+	REQUIRE(message == midi::Message { Type::Program_Change, 1, 5 });
+	REQUIRE_FALSE(ss >> message);
+}
+
+#endif
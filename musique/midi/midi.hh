@@ -1,17 +1,30 @@
 #pragma once
 #include <RtMidi.h>
+#include <chrono>
 #include <cstdint>
 #include <functional>
+#include <istream>
 #include <optional>
+#include <ostream>
+#include <span>
 #include <string>
+#include <vector>
 
 // Documentation of midi messages available at http://midi.teragonaudio.com/tech/midispec.htm
 namespace midi
 {
+	struct Message;
+
 	struct Connection
 	{
+		Connection();
+		Connection(Connection const&) = delete;
+		Connection& operator=(Connection const&) = delete;
 		virtual ~Connection() = default;
 
+		/// Unique id of connection, never reused by connections created later
+		unsigned const id;
+
 		virtual bool supports_output() const = 0;
 
 		virtual void send_note_on (uint8_t channel, uint8_t note_number, uint8_t velocity) = 0;
@@ -20,8 +33,60 @@ namespace midi
 		virtual void send_controller_change(uint8_t channel, uint8_t controller_number, uint8_t value) = 0;
 
 		void send_all_sounds_off(uint8_t channel);
+
+		/// Send messages due at the same instant together
+		///
+		/// By default they are sent one by one, connections that can write many messages at once override it.
+		virtual void send_batch(std::span<Message const> messages);
+
+		/// Set time at which following messages are sent
+		///
+		/// Connections sending messages immediately ignore it, ones recording messages use it as their timestamp.
+		virtual void set_time(std::chrono::steady_clock::time_point) {}
+	};
+
+	/// Channel message that can be sent through any connection
+	struct Message
+	{
+		enum class Type : uint8_t
+		{
+			Note_On,
+			Note_Off,
+			Program_Change,
+			Controller_Change,
+		};
+
+		Type type;
+		uint8_t channel = 0;
+		uint8_t first = 0;  ///< Note, program or controller number
+		uint8_t second = 0; ///< Velocity or controller value
+
+		/// Send message through given connection
+		void send(Connection &connection) const;
+
+		/// Status byte of the message, combining its type and channel
+		uint8_t status() const;
+
+		/// Count of data bytes following status byte
+		unsigned data_size() const;
+
+		bool operator==(Message const&) const = default;
 	};
 
+	/// Print message as its type, channel and data bytes, like `note-on 0 60 127`
+	std::ostream& operator<<(std::ostream& os, Message const& message);
+
+	/// Read message printed by operator<<, setting failbit when it isn't valid
+	std::istream& operator>>(std::istream& is, Message& message);
+
+	/// Decode channel message from its bytes, Note On with zero velocity becomes Note Off
+	///
+	/// Other kinds of messages aren't supported and result in nothing.
+	std::optional<Message> decode(std::span<uint8_t const> bytes);
+
+	/// Append bytes of messages, omitting status byte when it's the same as previous one (running status)
+	void append_with_running_status(std::vector<uint8_t> &bytes, std::span<Message const> messages);
+
 	struct Rt_Midi : Connection
 	{
 		~Rt_Midi() override = default;
@@ -45,7 +110,13 @@ namespace midi
 		void send_program_change(uint8_t channel, uint8_t program) override;
 		void send_controller_change(uint8_t channel, uint8_t controller_number, uint8_t value) override;
 
+		void send_batch(std::span<Message const> messages) override;
+
 		std::optional<RtMidiOut> output;
+
+	private:
+		/// Bytes of batch being sent, kept between batches to reuse its allocation
+		std::vector<uint8_t> batch;
 	};
 
 	/// All defined controllers for controller change message
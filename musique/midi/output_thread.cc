@@ -0,0 +1,363 @@
+#include <algorithm>
+#include <musique/midi/output_thread.hh>
+
+midi::Output_Thread::~Output_Thread()
+{
+	if (thread.joinable()) {
+		stopping = true;
+		scheduled.fetch_add(1);
+		scheduled.notify_one();
+		thread.join();
+	}
+}
+
+void midi::Output_Thread::schedule(std::shared_ptr<Connection> connection, Message message, std::chrono::steady_clock::time_point when,
+	std::optional<std::chrono::steady_clock::time_point> answers)
+{
+	if (!thread.joinable()) {
+		thread = std::thread([this] { run(); });
+	}
+
+	auto &table = voices.table_of(connection);
+	auto const timed = Timed_Message {
+		.when = when,
+		.connection = std::move(connection),
+		.voices = &table,
+		.message = message,
+		.epoch = epoch.load(),
+		.answers = answers,
+	};
+
+	while (!queue.push(timed)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	scheduled.fetch_add(1, std::memory_order_release);
+	scheduled.notify_one();
+}
+
+void midi::Output_Thread::cancel()
+{
+	unsigned current;
+	{
+		std::lock_guard lock(mutex);
+		current = epoch.fetch_add(1) + 1;
+	}
+	cancelled.notify_all();
+
+	if (!thread.joinable()) {
+		return;
+	}
+
+	// Wake thread that is idle, so it acknowledges new epoch too
+	scheduled.fetch_add(1, std::memory_order_release);
+	scheduled.notify_one();
+
+	// Batch that is being sent may turn notes on, which voices must know about before they are turned off
+	for (auto seen = acknowledged.load(); seen != current; seen = acknowledged.load()) {
+		acknowledged.wait(seen);
+	}
+}
+
+std::size_t midi::Output_Thread::pending() const
+{
+	return queue.size();
+}
+
+midi::Latency midi::Output_Thread::latency() const
+{
+	std::lock_guard lock(measured_mutex);
+	return measured;
+}
+
+void midi::Output_Thread::add_latency(std::chrono::steady_clock::duration latency)
+{
+	std::lock_guard lock(measured_mutex);
+	measured.add(latency);
+}
+
+void midi::Latency::add(std::chrono::steady_clock::duration latency)
+{
+	++count;
+	min = std::min(min, latency);
+	max = std::max(max, latency);
+	total += latency;
+}
+
+void midi::Output_Thread::run()
+{
+	for (;;) {
+		auto const seen = scheduled.load(std::memory_order_acquire);
+
+		// Nothing is being sent now, so everything sent before is already counted by voices
+		auto const current = epoch.load();
+		if (acknowledged.exchange(current) != current) {
+			acknowledged.notify_all();
+		}
+
+		auto const timed = queue.front();
+		if (timed == nullptr) {
+			if (stopping) {
+				return;
+			}
+			scheduled.wait(seen);
+			continue;
+		}
+
+		if (timed->epoch == current) {
+			std::unique_lock lock(mutex);
+			if (cancelled.wait_until(lock, timed->when, [&] { return epoch != current; })) {
+				// Cancelled while waiting, acknowledge it before sending anything
+				continue;
+			}
+		}
+
+		// Messages due at the same instant on the same connection are sent together
+		batch.clear();
+		std::optional<std::chrono::steady_clock::time_point> answers;
+		std::size_t count = 0;
+		for (Timed_Message *next = timed; next; next = queue.peek(++count)) {
+			if (next->when != timed->when || next->connection != timed->connection) {
+				break;
+			}
+			// Cancelled notes are turned off anyway, since they may have been already turned on
+			if (next->epoch == current || next->message.type == Message::Type::Note_Off) {
+				batch.push_back(next->message);
+				answers = answers ? answers : next->answers;
+			}
+		}
+
+		if (!batch.empty()) {
+			timed->connection->send_batch(batch);
+			if (answers) {
+				add_latency(std::chrono::steady_clock::now() - *answers);
+			}
+			for (auto const& message : batch) {
+				Voices::sent(*timed->voices, message);
+			}
+		}
+		queue.pop(count);
+	}
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+#include <vector>
+
+namespace
+{
+	struct Recording_Connection : midi::Connection
+	{
+		std::vector<std::pair<midi::Message, std::chrono::steady_clock::time_point>> sent;
+
+		bool supports_output() const override { return true; }
+
+		void send_note_on(uint8_t channel, uint8_t note_number, uint8_t velocity) override
+		{
+			record({ midi::Message::Type::Note_On, channel, note_number, velocity });
+		}
+
+		void send_note_off(uint8_t channel, uint8_t note_number, uint8_t velocity) override
+		{
+			record({ midi::Message::Type::Note_Off, channel, note_number, velocity });
+		}
+
+		void send_program_change(uint8_t channel, uint8_t program) override
+		{
+			record({ midi::Message::Type::Program_Change, channel, program });
+		}
+
+		void send_controller_change(uint8_t channel, uint8_t controller_number, uint8_t value) override
+		{
+			record({ midi::Message::Type::Controller_Change, channel, controller_number, value });
+		}
+
+		void send_batch(std::span<midi::Message const> messages) override
+		{
+			batch_sizes.push_back(messages.size());
+			Connection::send_batch(messages);
+		}
+
+		void record(midi::Message message)
+		{
+			sent.emplace_back(message, std::chrono::steady_clock::now());
+		}
+
+		std::vector<std::size_t> batch_sizes;
+	};
+
+	/// Connection that takes its time to send a batch, so it can be cancelled in the middle of it
+	struct Slow_Connection : Recording_Connection
+	{
+		std::atomic<bool> sending = false;
+
+		void send_batch(std::span<midi::Message const> messages) override
+		{
+			sending = true;
+			sending.notify_all();
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			Recording_Connection::send_batch(messages);
+		}
+	};
+}
+
+TEST_CASE("Single producer single consumer queue", "[spsc]")
+{
+	Spsc_Queue<int, 4> queue;
+	REQUIRE(queue.front() == nullptr);
+
+	for (int i = 0; i < 4; ++i) {
+		REQUIRE(queue.push(i));
+	}
+	REQUIRE_FALSE(queue.push(4));
+	REQUIRE(queue.size() == 4);
+
+	for (int i = 0; i < 6; ++i) {
+		REQUIRE(*queue.front() == i);
+		queue.pop();
+		REQUIRE(queue.push(i + 4));
+	}
+	REQUIRE(queue.size() == 4);
+}
+
+TEST_CASE("Sending messages at their time", "[midi]")
+{
+	using namespace std::chrono_literals;
+	using Type = midi::Message::Type;
+
+	auto const connection = std::make_shared<Recording_Connection>();
+	auto const start = std::chrono::steady_clock::now();
+	{
+		midi::Output_Thread output;
+		output.schedule(connection, { Type::Note_On,  0, 60, 127 }, start + 10ms);
+		output.schedule(connection, { Type::Note_Off, 0, 60, 127 }, start + 20ms);
+		output.schedule(connection, { Type::Program_Change, 1, 4 }, start + 20ms);
+	}
+
+	REQUIRE(connection->sent.size() == 3);
+	REQUIRE(connection->sent[0].first == midi::Message { Type::Note_On, 0, 60, 127 });
+	REQUIRE(connection->sent[1].first == midi::Message { Type::Note_Off, 0, 60, 127 });
+	REQUIRE(connection->sent[2].first == midi::Message { Type::Program_Change, 1, 4 });
+	REQUIRE(connection->sent[0].second >= start + 10ms);
+	REQUIRE(connection->sent[1].second >= start + 20ms);
+}
+
+TEST_CASE("Cancelling scheduled messages", "[midi]")
+{
+	using namespace std::chrono_literals;
+	using Type = midi::Message::Type;
+
+	auto const connection = std::make_shared<Recording_Connection>();
+	auto const start = std::chrono::steady_clock::now();
+	{
+		midi::Output_Thread output;
+		output.schedule(connection, { Type::Note_On,  0, 60, 127 }, start + 10s);
+		output.schedule(connection, { Type::Note_Off, 0, 60, 127 }, start + 20s);
+		output.cancel();
+		output.schedule(connection, { Type::Note_On,  0, 62, 127 }, start);
+	}
+
+	REQUIRE(connection->sent.size() == 2);
+	REQUIRE(connection->sent[0].first == midi::Message { Type::Note_Off, 0, 60, 127 });
+	REQUIRE(connection->sent[1].first == midi::Message { Type::Note_On,  0, 62, 127 });
+	REQUIRE(connection->sent[1].second < start + 10s);
+}
+
+TEST_CASE("Sending simultaneous messages together", "[midi]")
+{
+	using namespace std::chrono_literals;
+	using Type = midi::Message::Type;
+
+	auto const connection = std::make_shared<Recording_Connection>();
+	auto const start = std::chrono::steady_clock::now();
+	{
+		midi::Output_Thread output;
+		for (uint8_t note = 60; note < 64; ++note) {
+			output.schedule(connection, { Type::Note_On, 0, note, 127 }, start + 10ms);
+		}
+		for (uint8_t note = 60; note < 64; ++note) {
+			output.schedule(connection, { Type::Note_Off, 0, note, 127 }, start + 20ms);
+		}
+	}
+
+	REQUIRE(connection->sent.size() == 8);
+	REQUIRE(connection->batch_sizes == std::vector<std::size_t> { 4, 4 });
+}
+
+TEST_CASE("Counting notes when they are sent", "[midi]")
+{
+	using namespace std::chrono_literals;
+	using Type = midi::Message::Type;
+
+	auto const connection = std::make_shared<Recording_Connection>();
+	midi::Output_Thread output;
+	auto const start = std::chrono::steady_clock::now();
+	output.schedule(connection, { Type::Note_On,  0, 60, 127 }, start + 100ms);
+	output.schedule(connection, { Type::Note_On,  0, 64, 127 }, start + 100ms);
+	output.schedule(connection, { Type::Note_Off, 0, 60, 127 }, start + 200ms);
+	output.schedule(connection, { Type::Note_Off, 0, 64, 127 }, start + 300ms);
+
+	// Scheduled notes don't sound yet
+	REQUIRE(output.voices.count() == 0);
+
+	std::this_thread::sleep_until(start + 150ms);
+	REQUIRE(output.voices.count(0) == 2);
+
+	std::this_thread::sleep_until(start + 250ms);
+	REQUIRE(output.voices.count(0) == 1);
+
+	std::this_thread::sleep_until(start + 350ms);
+	REQUIRE(output.voices.count() == 0);
+}
+
+TEST_CASE("Measuring latency when answer is sent", "[midi]")
+{
+	using namespace std::chrono_literals;
+	using Type = midi::Message::Type;
+
+	auto const connection = std::make_shared<Recording_Connection>();
+	midi::Output_Thread output;
+	auto const received = std::chrono::steady_clock::now();
+	output.schedule(connection, { Type::Note_On,  0, 60, 127 }, received + 20ms, received);
+	output.schedule(connection, { Type::Note_Off, 0, 60, 127 }, received + 30ms);
+
+	// Answer isn't measured until it's sent
+	REQUIRE(output.latency().count == 0);
+
+	std::this_thread::sleep_until(received + 100ms);
+	auto const latency = output.latency();
+	REQUIRE(latency.count == 1);
+	REQUIRE(latency.min >= 20ms);
+	REQUIRE(latency.min == latency.max);
+}
+
+TEST_CASE("Cancelling waits for batch that is being sent", "[midi]")
+{
+	using Type = midi::Message::Type;
+
+	auto const connection = std::make_shared<Slow_Connection>();
+	midi::Output_Thread output;
+	output.schedule(connection, { Type::Note_On, 0, 60, 127 }, std::chrono::steady_clock::now());
+	connection->sending.wait(false);
+
+	output.cancel();
+	REQUIRE(connection->sent.size() == 1);
+	REQUIRE(output.voices.count(0) == 1);
+}
+
+TEST_CASE("Scheduled messages keep their connection alive", "[midi]")
+{
+	using Type = midi::Message::Type;
+
+	auto connection = std::make_shared<Recording_Connection>();
+	std::weak_ptr<Recording_Connection> const alive = connection;
+	{
+		midi::Output_Thread output;
+		output.schedule(connection, { Type::Note_On, 0, 60, 127 }, std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+		connection.reset();
+		REQUIRE_FALSE(alive.expired());
+	}
+	REQUIRE(alive.expired());
+}
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef MUSIQUE_MIDI_OUTPUT_THREAD_HH
+#define MUSIQUE_MIDI_OUTPUT_THREAD_HH
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <musique/midi/midi.hh>
+#include <musique/midi/voices.hh>
+#include <musique/spsc_queue.hh>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace midi
+{
+	/// Message waiting in output queue for the time it should be sent at
+	struct Timed_Message
+	{
+		std::chrono::steady_clock::time_point when;
+
+		/// Connection kept alive by message, released when its slot in queue is reused by thread scheduling messages
+		std::shared_ptr<Connection> connection;
+
+		/// Voices of connection, counting notes when message is sent. Kept while message holds its connection.
+		Voices::Table *voices = nullptr;
+
+		Message message = {};
+		unsigned epoch = 0;
+
+		/// Arrival time of received message this one answers, so latency is measured when it's sent
+		std::optional<std::chrono::steady_clock::time_point> answers = std::nullopt;
+	};
+
+	/// Time from receiving message to sending first message after it, measuring how fast program responds
+	struct Latency
+	{
+		unsigned count = 0;
+		std::chrono::steady_clock::duration min = std::chrono::steady_clock::duration::max();
+		std::chrono::steady_clock::duration max = {};
+		std::chrono::steady_clock::duration total = {};
+
+		void add(std::chrono::steady_clock::duration latency);
+	};
+
+	/// Thread sending MIDI messages at their times, so evaluation doesn't delay playback
+	///
+	/// Messages are sent in order they were scheduled in, each not earlier than at its time.
+	/// Consecutive messages due at the same instant are sent to their connection as one batch.
+	/// Only one thread may schedule messages. Messages share ownership of their connections,
+	/// so thread sending them never frees connection dropped by the program.
+	struct Output_Thread
+	{
+		/// How many messages can wait in the queue before scheduling blocks
+		static constexpr std::size_t Capacity = 4096;
+
+		Output_Thread() = default;
+		Output_Thread(Output_Thread const&) = delete;
+		Output_Thread& operator=(Output_Thread const&) = delete;
+
+		/// Sends all scheduled messages and stops the thread
+		~Output_Thread();
+
+		/// Schedule message to be sent at given time, blocks while queue is full
+		///
+		/// When message answers received one, time from its arrival to actual sending is added to latency.
+		void schedule(std::shared_ptr<Connection> connection, Message message, std::chrono::steady_clock::time_point when,
+			std::optional<std::chrono::steady_clock::time_point> answers = std::nullopt);
+
+		/// Drop all scheduled messages except note offs, which are sent immediately
+		///
+		/// Returns after the thread finished sending messages scheduled before, so notes they
+		/// turned on are already counted by voices.
+		void cancel();
+
+		/// Count of messages waiting to be sent
+		std::size_t pending() const;
+
+		/// Notes turned on by messages sent so far and not turned off yet
+		///
+		/// Its tables are written only by the thread, other users may only read them.
+		Voices voices;
+
+		/// Latency of answers to received messages, measured when they were sent
+		Latency latency() const;
+
+		/// Add latency of answer that was sent without this thread, like with virtual clock
+		void add_latency(std::chrono::steady_clock::duration latency);
+
+	private:
+		void run();
+
+		Spsc_Queue<Timed_Message, Capacity> queue;
+
+		/// Incremented on each cancel, messages from previous epochs are not played
+		std::atomic<unsigned> epoch = 0;
+
+		/// Epoch seen by the thread when it's not sending, cancel waits for it to catch up
+		std::atomic<unsigned> acknowledged = 0;
+
+		/// Incremented on each scheduled message, idle thread waits for it to change
+		std::atomic<unsigned> scheduled = 0;
+
+		std::atomic<bool> stopping = false;
+
+		/// Messages sent together by the thread, kept between batches to reuse its allocation
+		std::vector<Message> batch;
+
+		/// Latency of answers sent so far, updated by the thread and read by interpreter
+		Latency measured;
+		mutable std::mutex measured_mutex;
+
+		/// Used only to wake thread waiting for time of message when it's cancelled
+		std::mutex mutex;
+		std::condition_variable cancelled;
+
+		std::thread thread;
+	};
+}
+
+#endif // MUSIQUE_MIDI_OUTPUT_THREAD_HH
@@ -77,8 +77,7 @@ bool midi::Rt_Midi::supports_output() const
 	return bool(output);
 }
 
-template<std::size_t N>
-inline void send_message(RtMidiOut &out, std::array<std::uint8_t, N> message)
+static void send_message(RtMidiOut &out, std::span<std::uint8_t const> message)
 try {
 	out.sendMessage(message.data(), message.size());
 } catch (RtMidiError &error) {
@@ -115,3 +114,18 @@ void midi::Rt_Midi::send_controller_change(uint8_t channel, uint8_t controller_n
 	send_message(*output, std::array { std::uint8_t(Control_Change + channel), controller_number, value });
 }
 
+void midi::Rt_Midi::send_batch(std::span<Message const> messages)
+{
+#ifdef __LINUX_ALSA__
+	// ALSA parses written bytes as a stream, so whole batch goes out in one write. Consecutive messages
+	// with the same status byte share it (running status), making simultaneous notes closer together.
+	batch.clear();
+	append_with_running_status(batch, messages);
+	if (!batch.empty()) {
+		send_message(*output, batch);
+	}
+#else
+	// Other backends accept only one message per write
+	Connection::send_batch(messages);
+#endif
+}
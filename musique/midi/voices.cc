@@ -0,0 +1,128 @@
+#include <musique/midi/voices.hh>
+
+#include <algorithm>
+#include <numeric>
+
+void midi::Voices::sent(Table &table, Message message)
+{
+	if (message.channel >= Channels || message.first >= Notes) {
+		return;
+	}
+
+	// Only this thread writes counters, so they are updated without read-modify-write
+	auto &count = table.notes[message.channel][message.first];
+	auto &per_channel = table.per_channel[message.channel];
+	if (message.type == Message::Type::Note_On) {
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		per_channel.store(per_channel.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	} else if (message.type == Message::Type::Note_Off) {
+		// Notes that aren't sounding are ignored
+		if (auto const n = count.load(std::memory_order_relaxed); n > 0) {
+			count.store(n - 1, std::memory_order_relaxed);
+			per_channel.store(per_channel.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+		}
+	}
+}
+
+unsigned midi::Voices::count(uint8_t channel) const
+{
+	if (channel >= Channels) {
+		return 0;
+	}
+	return std::accumulate(tables.begin(), tables.end(), 0u, [&](unsigned sum, std::unique_ptr<Table> const& table) {
+		return sum + table->per_channel[channel].load(std::memory_order_relaxed);
+	});
+}
+
+unsigned midi::Voices::count() const
+{
+	auto sum = 0u;
+	for (auto channel = 0u; channel < Channels; ++channel) {
+		sum += count(channel);
+	}
+	return sum;
+}
+
+midi::Voices::Table& midi::Voices::table_of(std::shared_ptr<Connection> const& port)
+{
+	auto const id = port ? port->id : 0u;
+	auto table = std::find_if(tables.begin(), tables.end(), [&](std::unique_ptr<Table> const& table) { return table->port_id == id; });
+	if (table != tables.end()) {
+		return **table;
+	}
+
+	std::erase_if(tables, [](std::unique_ptr<Table> const& table) { return table->port_id != 0 && table->port.expired(); });
+
+	auto &created = *tables.emplace_back(std::make_unique<Table>());
+	created.port_id = id;
+	created.port = port;
+	return created;
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+#include <musique/midi/file.hh>
+
+TEST_CASE("Counting sounding notes", "[midi]")
+{
+	using Type = midi::Message::Type;
+
+	midi::Voices voices;
+	std::shared_ptr<midi::Connection> const first = nullptr, second = std::make_shared<midi::File>();
+
+	auto &first_table = voices.table_of(first);
+	auto &second_table = voices.table_of(second);
+	REQUIRE(&voices.table_of(second) == &second_table);
+
+	midi::Voices::sent(first_table, { Type::Note_On, 0, 60, 127 });
+	midi::Voices::sent(first_table, { Type::Note_On, 0, 60, 127 });
+	midi::Voices::sent(first_table, { Type::Note_On, 3, 64, 127 });
+	midi::Voices::sent(second_table, { Type::Note_On, 3, 67, 127 });
+	midi::Voices::sent(second_table, { Type::Program_Change, 3, 1 });
+	REQUIRE(voices.count(0) == 2);
+	REQUIRE(voices.count(3) == 2);
+	REQUIRE(voices.count() == 4);
+
+	// Turning off note that isn't sounding is ignored
+	midi::Voices::sent(second_table, { Type::Note_Off, 0, 60, 0 });
+	midi::Voices::sent(first_table, { Type::Note_Off, 0, 60, 0 });
+	REQUIRE(voices.count(0) == 1);
+
+	// Note offs are counted when they are sent, like any other message
+	std::vector<std::pair<std::shared_ptr<midi::Connection>, midi::Message>> sent;
+	voices.turn_off_all([&](std::shared_ptr<midi::Connection> const& port, midi::Message message) { sent.emplace_back(port, message); });
+	REQUIRE(voices.count() == 3);
+	REQUIRE(sent == std::vector<std::pair<std::shared_ptr<midi::Connection>, midi::Message>> {
+		{ nullptr, { Type::Note_Off, 0, 60, 0 } },
+		{ nullptr, { Type::Note_Off, 3, 64, 0 } },
+		{ second,  { Type::Note_Off, 3, 67, 0 } },
+	});
+
+	for (auto const& [port, message] : sent) {
+		midi::Voices::sent(voices.table_of(port), message);
+	}
+	REQUIRE(voices.count() == 0);
+}
+
+TEST_CASE("Voices of freed port are dropped", "[midi]")
+{
+	midi::Voices voices;
+	auto port = std::make_shared<midi::File>();
+
+	auto const freed_id = port->id;
+	midi::Voices::sent(voices.table_of(port), { midi::Message::Type::Note_On, 0, 60, 127 });
+	REQUIRE(voices.count(0) == 1);
+
+	// Notes of freed port can't be turned off anymore
+	port = std::make_shared<midi::File>();
+	std::vector<std::shared_ptr<midi::Connection>> turned_off;
+	voices.turn_off_all([&](std::shared_ptr<midi::Connection> const& port, midi::Message) { turned_off.push_back(port); });
+	REQUIRE(turned_off.empty());
+
+	REQUIRE(port->id != freed_id);
+	REQUIRE(voices.table_of(port).per_channel[0] == 0);
+	REQUIRE(voices.count(0) == 0);
+}
+
+#endif
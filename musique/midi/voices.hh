@@ -0,0 +1,96 @@
+#ifndef MUSIQUE_MIDI_VOICES_HH
+#define MUSIQUE_MIDI_VOICES_HH
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <musique/midi/midi.hh>
+#include <utility>
+#include <vector>
+
+namespace midi
+{
+	/// Notes that were turned on and not turned off yet, for each port, channel and note number
+	///
+	/// Notes are counted when their messages are sent, so it reflects what is sounding right now,
+	/// not what was scheduled. Each port has fixed table of counters, allocated by thread scheduling
+	/// messages before first message to that port is queued. Thread sending messages is the only one
+	/// writing counters, so turning notes on and off is constant time, doesn't lock and doesn't allocate.
+	///
+	/// Tables are found by stable id of port, so port created at address of freed one gets a new table.
+	/// Tables only observe their ports, and table of port that was freed is dropped with its notes,
+	/// since nothing can turn them off anymore.
+	struct Voices
+	{
+		static constexpr unsigned Channels = 16;
+		static constexpr unsigned Notes = 128;
+
+		/// Counters of notes sounding at one port, published to other threads through atomics
+		struct Table
+		{
+			/// Id of port that table counts notes of, 0 when notes are not sent to any port
+			unsigned port_id = 0;
+
+			/// Port that table counts notes of, expired when port was freed
+			std::weak_ptr<Connection> port;
+
+			std::array<std::array<std::atomic<uint16_t>, Notes>, Channels> notes = {};
+			std::array<std::atomic<unsigned>, Channels> per_channel = {};
+		};
+
+		/// Table of given port, allocated when port is seen for the first time
+		///
+		/// Tables of freed ports are dropped when new one is allocated. Thread sending messages
+		/// uses table only while message holding its port waits in queue, so such table is unused.
+		/// Called only by thread scheduling messages.
+		Table& table_of(std::shared_ptr<Connection> const& port);
+
+		/// Count note on and note off messages sent with given table, ignoring all other messages
+		///
+		/// Called only by thread sending messages.
+		static void sent(Table &table, Message message);
+
+		/// Count of notes sounding on given channel, summed over all ports
+		unsigned count(uint8_t channel) const;
+
+		/// Count of all notes sounding
+		unsigned count() const;
+
+		/// Call given function with port and note off message for each sounding note
+		///
+		/// Counters are left to messages given to function, which are counted when they are sent.
+		/// Notes of freed ports are skipped. Called only by thread scheduling messages.
+		template<typename Send>
+		void turn_off_all(Send &&send)
+		{
+			std::vector<std::pair<std::shared_ptr<Connection>, Message>> sounding;
+			for (auto const& table : tables) {
+				auto port = table->port.lock();
+				if (table->port_id != 0 && port == nullptr) {
+					continue;
+				}
+				for (auto channel = 0u; channel < Channels; ++channel) {
+					if (table->per_channel[channel].load(std::memory_order_relaxed) == 0) {
+						continue;
+					}
+					for (auto note = 0u; note < Notes; ++note) {
+						for (auto n = table->notes[channel][note].load(std::memory_order_relaxed); n > 0; --n) {
+							sounding.emplace_back(port, Message { Message::Type::Note_Off, uint8_t(channel), uint8_t(note), 0 });
+						}
+					}
+				}
+			}
+
+			for (auto const& [port, message] : sounding) {
+				send(port, message);
+			}
+		}
+
+	private:
+		/// Usually there are only few ports, so they are searched linearly
+		std::vector<std::unique_ptr<Table>> tables;
+	};
+}
+
+#endif // MUSIQUE_MIDI_VOICES_HH
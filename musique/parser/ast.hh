@@ -2,9 +2,36 @@
 #define MUSIQUE_AST_HH
 
 #include <musique/lexer/token.hh>
+#include <musique/value/intrinsic.hh>
+#include <musique/value/symbol.hh>
+#include <unordered_map>
+#include <memory>
 #include <vector>
 #include <optional>
 
+/// Layout of frames created by calling lambda, computed by resolve()
+struct Frame_Layout
+{
+	/// Names of variables stored in frame slots
+	std::vector<Symbol> names;
+
+	/// Slot of each parameter
+	std::vector<u32> parameters;
+
+	/// Slot of variable with given name if frame has one
+	std::optional<u32> slot(Symbol name) const;
+};
+
+/// Place where variable lives, computed by resolve()
+struct Lexical_Address
+{
+	/// Layout of frame holding variable, nullptr when variable can only be found by name
+	Frame_Layout const* frame = nullptr;
+
+	/// Index of slot in frame
+	u32 slot = 0;
+};
+
 /// Representation of a node in program tree
 struct Ast
 {
@@ -52,6 +79,22 @@ struct Ast
 
 	/// Child nodes
 	std::vector<Ast> arguments{};
+
+	/// Interned name of identifier, symbol literal (without leading quote) or operator
+	Symbol symbol{};
+
+	/// Address of identifier (or identifier declared by Variable_Declaration)
+	Lexical_Address address{};
+
+	/// Layout of frames for lambdas with parameters
+	std::shared_ptr<Frame_Layout const> layout{};
+
+	/// Operator bound to Binary node or operator symbol literal like `'+`.
+	/// Null for special forms (`=`, `and`, `or`) and undefined operators.
+	Intrinsic::Function_Pointer intrinsic = nullptr;
+
+	/// Binary node is compound assignment like `x += 1`, with intrinsic being `+`
+	bool compound_assignment = false;
 };
 
 bool operator==(Ast const& lhs, Ast const& rhs);
@@ -61,6 +104,12 @@ std::ostream& operator<<(std::ostream& os, Ast const& tree);
 /// Pretty print program tree for debugging purposes
 void dump(Ast const& ast, unsigned indent = 0);
 
+/// Intern names, bind operators and assign lexical addresses to identifiers of tree
+///
+/// Only variables of lambdas with parameters, declared directly in their bodies, get slots.
+/// Everything else, including variables declared in nested blocks, is looked up by name.
+void resolve(Ast &ast, std::unordered_map<Symbol, Intrinsic> const& operators);
+
 template<> struct std::hash<Ast>    { std::size_t operator()(Ast    const&) const; };
 
 #endif
@@ -50,24 +50,24 @@ static Result<std::vector<Ast>> parse_many(
 
 Result<Ast> Parser::parse(std::string_view source, std::string_view filename, unsigned line_number)
 {
-	Lexer lexer{source};
-	lexer.location.filename = filename;
-	lexer.location.line = line_number;
 	Parser parser;
-
-	for (;;) {
-		auto token_or_eof = Try(lexer.next_token());
-		if (auto maybe_token = std::get_if<Token>(&token_or_eof); maybe_token) {
-			parser.tokens.emplace_back(std::move(*maybe_token));
-		} else {
-			// We encountered end of file so no more tokens, break the loop
-			break;
-		}
-	}
+	parser.lexer.source = source;
+	parser.lexer.location.filename = filename;
+	parser.lexer.location.line = line_number;
+	parser.last_location = parser.lexer.location;
 
 	auto const result = parser.parse_sequence();
 
-	if (result.has_value() && parser.token_id < parser.tokens.size()) {
+	// Tokens are lexed only when parser asks for them, but lexing errors
+	// are reported before parsing errors, as if whole source was lexed first
+	if (!result.has_value() || parser.token_at(0)) {
+		parser.lex_everything();
+	}
+	if (parser.lexer_error) {
+		return *std::move(parser.lexer_error);
+	}
+
+	if (result.has_value() && parser.token_at(0)) {
 		if (parser.expect(Token::Type::Close_Block)) {
 			auto const tok = parser.consume();
 			return Error {
@@ -78,7 +78,8 @@ Result<Ast> Parser::parse(std::string_view source, std::string_view filename, un
 			};
 		}
 
-		errors::all_tokens_were_not_parsed(std::span(parser.tokens).subspan(parser.token_id));
+		std::vector<Token> remaining(parser.lookahead.begin() + (parser.token_id - parser.first_buffered), parser.lookahead.end());
+		errors::all_tokens_were_not_parsed(remaining);
 	}
 
 	return result;
@@ -206,12 +207,13 @@ Result<Ast> parse_sequence_inside(
 	auto ast = Try(parser.parse_sequence());
 	if (not parser.expect(closing_token)) {
 		Try(dont_arrived_at_closing_token());
+		parser.lex_everything();
 		return Error {
 			.details = errors::Unexpected_Empty_Source {
 				.reason = errors::Unexpected_Empty_Source::Block_Without_Closing_Bracket,
 				.start = start_location
 			},
-			.location = parser.tokens.back().location
+			.location = parser.last_location
 		};
 	}
 
@@ -281,14 +283,20 @@ Result<Ast> Parser::parse_atomic_expression()
 				return Ast::block(std::move(opening).location);
 			}
 
-			auto start = token_id;
 			std::vector<Ast> parameters;
 			bool is_lambda = false;
 
+			// Parameter separator ending identifier looking tokens that were not all symbols
+			// and the first of them that is not a symbol
+			std::optional<unsigned> invalid_parameters_end;
+			std::optional<Token> invalid_token;
+
 			if (expect(Token::Type::Parameter_Separator)) {
 				consume();
 				is_lambda = true;
 			} else {
+				auto const start = token_id;
+				++marks;
 				auto p = parse_many(*this, &Parser::parse_identifier_with_trailing_separators, std::nullopt, At_Least::One);
 				if (p && expect(Token::Type::Parameter_Separator)) {
 					consume();
@@ -296,7 +304,21 @@ Result<Ast> Parser::parse_atomic_expression()
 					is_lambda = true;
 				} else {
 					token_id = start;
+
+					// This may be a result of user trying to specify parameters from things that cannot be parameters (like chord literals).
+					// Tokens are checked now, while they are still buffered, and reported only if parsing of block stops at found separator.
+					unsigned offset = 0;
+					for (Token const* token; (token = token_at(offset)) && is_identifier_looking(token->type); ++offset) {
+						if (!invalid_token && token->type != Token::Type::Symbol) {
+							// TODO Maybe gather all tokens to provide all the help needed in the one iteration
+							invalid_token = *token;
+						}
+					}
+					if (auto const token = token_at(offset); token && token->type == Token::Type::Parameter_Separator) {
+						invalid_parameters_end = start + offset;
+					}
 				}
+				--marks;
 			}
 
 			return parse_sequence_inside(
@@ -313,19 +335,10 @@ Result<Ast> Parser::parse_atomic_expression()
 						ensure(false, "There should be error message that you cannot put multiple parameter separators in one block");
 					}
 
-					// This may be a result of user trying to specify parameters from things that cannot be parameters (like chord literals)
-					// or accidential hit of "|" on the keyboard. We can detect first case by ensuring that all tokens between this place
-					// and beggining of a block are identifier looking: keywords, symbols, literal chord declarations, boolean literals etc
-					std::optional<Token> invalid_token = std::nullopt;
-					auto const success = std::all_of(tokens.begin() + start, tokens.begin() + (token_id - start + 1), [&](Token const& token) {
-						if (!invalid_token && token.type != Token::Type::Symbol) {
-							// TODO Maybe gather all tokens to provide all the help needed in the one iteration
-							invalid_token = token;
-						}
-						return is_identifier_looking(token.type);
-					});
-
-					if (success && invalid_token) {
+					// Separator may be misplaced parameter list or accidential hit of "|" on the keyboard. We can detect first case
+					// by ensuring that all tokens between this place and beggining of a block are identifier looking:
+					// keywords, symbols, literal chord declarations, boolean literals etc
+					if (invalid_token && invalid_parameters_end == token_id) {
 						return Error {
 							.details = errors::Literal_As_Identifier {
 								.type_name = std::string(type_name(invalid_token->type)),
@@ -413,7 +426,7 @@ static Result<std::vector<Ast>> parse_many(
 		p.consume();
 	}
 
-	if (at_least == At_Least::Zero && p.token_id >= p.tokens.size()) {
+	if (at_least == At_Least::Zero && !p.token_at(0)) {
 		return {};
 	}
 
@@ -434,42 +447,82 @@ static Result<std::vector<Ast>> parse_many(
 	return trees;
 }
 
-Result<Token> Parser::peek() const
+Token const* Parser::token_at(unsigned offset)
 {
-	return token_id >= tokens.size()
-		? Error {
-				.details = errors::Unexpected_Empty_Source {},
-				.location = tokens.back().location
-			}
-		: Result<Token>(tokens[token_id]);
+	auto const id = token_id + offset - first_buffered;
+	while (lookahead.size() <= id && !lexed_everything) {
+		auto token_or_eof = lexer.next_token();
+		if (!token_or_eof.has_value()) {
+			lexer_error = std::move(token_or_eof).error();
+			lexed_everything = true;
+		} else if (auto token = std::get_if<Token>(&*token_or_eof)) {
+			last_location = token->location;
+			lookahead.push_back(std::move(*token));
+		} else {
+			lexed_everything = true;
+		}
+	}
+	return id < lookahead.size() ? &lookahead[id] : nullptr;
+}
+
+void Parser::lex_everything()
+{
+	while (!lexed_everything) {
+		token_at(first_buffered + lookahead.size() - token_id);
+	}
+}
+
+Result<Token> Parser::peek()
+{
+	if (auto const token = token_at(0)) {
+		return *token;
+	}
+	return Error {
+		.details = errors::Unexpected_Empty_Source {},
+		.location = last_location
+	};
 }
 
-Result<Token::Type> Parser::peek_type() const
+Result<Token::Type> Parser::peek_type()
 {
 	return peek().map([](Token const& token) { return token.type; });
 }
 
 Token Parser::consume()
 {
-	return std::move(tokens[token_id++]);
+	auto const token = token_at(0);
+	ensure(token, "Consumed token should be checked to exist first");
+	auto result = *token;
+	++token_id;
+
+	// Without anyone that may backtrack, consumed tokens are no longer needed.
+	// They are removed in batches, so lookahead is not shifted after each token.
+	if (marks == 0 && token_id - first_buffered >= 64) {
+		lookahead.erase(lookahead.begin(), lookahead.begin() + (token_id - first_buffered));
+		first_buffered = token_id;
+	}
+	return result;
 }
 
-bool Parser::expect(Token::Type type) const
+bool Parser::expect(Token::Type type)
 {
-	return token_id < tokens.size() && tokens[token_id].type == type;
+	auto const token = token_at(0);
+	return token && token->type == type;
 }
 
-bool Parser::expect(Token::Type type, std::string_view lexeme) const
+bool Parser::expect(Token::Type type, std::string_view lexeme)
 {
-	return token_id < tokens.size() && tokens[token_id].type == type && tokens[token_id].source == lexeme;
+	auto const token = token_at(0);
+	return token && token->type == type && token->source == lexeme;
 }
 
-bool Parser::expect(Token::Type t1, Token::Type t2, std::string_view lexeme_for_t2) const
+bool Parser::expect(Token::Type t1, Token::Type t2, std::string_view lexeme_for_t2)
 {
-	return token_id+1 < tokens.size()
-		&& tokens[token_id].type == t1
-		&& tokens[token_id+1].type == t2
-		&& tokens[token_id+1].source == lexeme_for_t2;
+	if (!expect(t1)) {
+		return false;
+	}
+	auto const next = token_at(1);
+	return next && next->type == t2 && next->source == lexeme_for_t2;
 }
 
 // Don't know if it's a good idea to defer parsing of literal values up to value creation, which is current approach.
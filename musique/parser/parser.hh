@@ -1,6 +1,7 @@
 #ifndef MUSIQUE_PARSER_HH
 #define MUSIQUE_PARSER_HH
 
+#include <musique/lexer/lexer.hh>
 #include <musique/parser/ast.hh>
 #include <musique/result.hh>
 
@@ -9,12 +10,30 @@
 /// Intended to be used by library user only by Parser::parse() static function.
 struct Parser
 {
-	/// List of tokens yielded from source
-	std::vector<Token> tokens;
+	/// Source of tokens, asked for next one only when parser needs it
+	Lexer lexer;
 
-	/// Current token id (offset in tokens array)
+	/// Tokens yielded from lexer that were not consumed yet or may be backtracked to
+	std::vector<Token> lookahead;
+
+	/// Current token id (number of tokens consumed since start of source)
 	unsigned token_id = 0;
 
+	/// Id of first token in lookahead
+	unsigned first_buffered = 0;
+
+	/// Count of active backtracking marks. While there are any consumed tokens are kept
+	unsigned marks = 0;
+
+	/// Lexer reached end of source or failed
+	bool lexed_everything = false;
+
+	/// Error that stopped lexer, reported before any parsing error
+	std::optional<Error> lexer_error;
+
+	/// Location of the last token yielded from lexer
+	Location last_location;
+
 	/// Parses whole source code producing Ast or Error
 	/// using Parser structure internally
 	static Result<Ast> parse(std::string_view source, std::string_view filename, unsigned line_number = 0);
@@ -46,23 +65,29 @@ struct Parser
 	/// Utility function for identifier parsing
 	Result<Ast> parse_identifier();
 
+	/// Token with given offset from current one, lexing it if needed. Null at the end of source
+	Token const* token_at(unsigned offset);
+
+	/// Lex rest of the source into lookahead, used only for error reporting
+	void lex_everything();
+
 	/// Peek current token
-	Result<Token> peek() const;
+	Result<Token> peek();
 
 	/// Peek type of the current token
-	Result<Token::Type> peek_type() const;
+	Result<Token::Type> peek_type();
 
 	/// Consume current token
 	Token consume();
 
 	/// Tests if current token has given type
-	bool expect(Token::Type type) const;
+	bool expect(Token::Type type);
 
 	/// Tests if current token has given type and source
-	bool expect(Token::Type type, std::string_view lexeme) const;
+	bool expect(Token::Type type, std::string_view lexeme);
 
 	// Tests if current token has given type and the next token has given type and source
-	bool expect(Token::Type t1, Token::Type t2, std::string_view lexeme_for_t2) const;
+	bool expect(Token::Type t1, Token::Type t2, std::string_view lexeme_for_t2);
 };
 
 #endif
@@ -0,0 +1,235 @@
+#include <musique/parser/ast.hh>
+
+#include <algorithm>
+#include <span>
+#include <unordered_set>
+
+std::optional<u32> Frame_Layout::slot(Symbol name) const
+{
+	if (auto it = std::find(names.begin(), names.end(), name); it != names.end()) {
+		return it - names.begin();
+	}
+	return std::nullopt;
+}
+
+static bool is_identifier(Ast const& ast)
+{
+	return ast.type == Ast::Type::Literal && ast.token.type == Token::Type::Symbol && !ast.token.source.starts_with('\'');
+}
+
+/// Collect names declared inside tree, optionally skipping declarations inside nested blocks
+template<typename Names>
+static void collect_declarations(Ast const& ast, bool nested, Names &names)
+{
+	if (ast.type == Ast::Type::Variable_Declaration && ast.arguments.size() == 2 && is_identifier(ast.arguments.front())) {
+		names.insert(names.end(), Symbol(ast.arguments.front().token.source));
+	}
+
+	if (!nested && (ast.type == Ast::Type::Block || ast.type == Ast::Type::Lambda)) {
+		return;
+	}
+
+	for (auto const& a : ast.arguments) {
+		collect_declarations(a, nested, names);
+	}
+}
+
+namespace
+{
+	/// Block or lambda enclosing currently resolved node
+	struct Scope
+	{
+		/// Layout of lambda frame, nullptr for blocks that are looked up by name
+		Frame_Layout const* layout;
+
+		/// Names declared anywhere inside scope. Blocks may be evaluated in any frame
+		/// (for example when indexed), so such names can be found only by name lookup.
+		std::unordered_set<Symbol> declared;
+	};
+
+	struct Resolver
+	{
+		std::unordered_map<Symbol, Intrinsic> const& operators;
+		std::vector<Scope> scopes = {};
+
+		Intrinsic::Function_Pointer find_operator(Symbol name) const
+		{
+			auto op = operators.find(name);
+			return op == operators.end() ? nullptr : op->second.function_pointer;
+		}
+
+		/// Bind operator to Binary node, in the same order as special forms are checked by interpreter
+		void bind_operator(Ast &ast) const
+		{
+			auto const source = ast.token.source;
+			if (source == "=" || source == "and" || source == "or") {
+				return;
+			}
+
+			if ((ast.intrinsic = find_operator(ast.symbol))) {
+				return;
+			}
+
+			if (source.ends_with('=')) {
+				ast.intrinsic = find_operator(Symbol(source.substr(0, source.size()-1)));
+				ast.compound_assignment = ast.intrinsic != nullptr;
+			}
+		}
+
+		Lexical_Address lookup(Symbol name) const
+		{
+			for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+				if (scope->layout) {
+					if (auto slot = scope->layout->slot(name)) {
+						return { .frame = scope->layout, .slot = *slot };
+					}
+				}
+				if (scope->declared.contains(name)) {
+					return {};
+				}
+			}
+			return {};
+		}
+
+		void enter(Frame_Layout const* layout, Ast const& body)
+		{
+			Scope scope { .layout = layout, .declared = {} };
+			collect_declarations(body, true, scope.declared);
+			scopes.push_back(std::move(scope));
+		}
+
+		void resolve(Ast &ast)
+		{
+			switch (ast.type) {
+			break; case Ast::Type::Literal:
+				if (ast.token.type == Token::Type::Symbol) {
+					ast.symbol = Symbol(ast.token.source.starts_with('\'') ? ast.token.source.substr(1) : ast.token.source);
+					if (ast.token.source.starts_with('\'')) {
+						ast.intrinsic = find_operator(ast.symbol);
+					}
+				}
+				if (is_identifier(ast)) {
+					ast.address = lookup(ast.symbol);
+				}
+
+			break; case Ast::Type::Variable_Declaration:
+				if (ast.arguments.size() == 2 && is_identifier(ast.arguments.front())) {
+					auto &name = ast.arguments.front();
+					name.symbol = Symbol(name.token.source);
+
+					// Only declarations directly in lambda body are guaranteed to be executed in its frame
+					if (!scopes.empty() && scopes.back().layout) {
+						auto const layout = scopes.back().layout;
+						name.address = { .frame = layout, .slot = *layout->slot(name.symbol) };
+					}
+					resolve(ast.arguments.back());
+				}
+
+			break; case Ast::Type::Lambda:
+				if (ast.arguments.size() > 1) {
+					auto &body = ast.arguments.back();
+					auto layout = std::make_shared<Frame_Layout>();
+
+					for (auto &parameter : std::span(ast.arguments).subspan(0, ast.arguments.size() - 1)) {
+						parameter.symbol = Symbol(parameter.token.source);
+						auto const slot = layout->slot(parameter.symbol);
+						layout->parameters.push_back(slot ? *slot : layout->names.size());
+						if (!slot) {
+							layout->names.push_back(parameter.symbol);
+						}
+					}
+
+					std::vector<Symbol> declared;
+					collect_declarations(body, false, declared);
+					for (auto name : declared) {
+						if (!layout->slot(name)) {
+							layout->names.push_back(name);
+						}
+					}
+
+					enter(layout.get(), body);
+					resolve(body);
+					scopes.pop_back();
+					ast.layout = std::move(layout);
+					break;
+				}
+				[[fallthrough]];
+
+			case Ast::Type::Block:
+				enter(nullptr, ast.arguments.back());
+				resolve(ast.arguments.back());
+				scopes.pop_back();
+
+			break; case Ast::Type::Binary:
+				ast.symbol = Symbol(ast.token.source);
+				bind_operator(ast);
+				for (auto &a : ast.arguments) {
+					resolve(a);
+				}
+
+			break; case Ast::Type::Call: case Ast::Type::Sequence:
+				for (auto &a : ast.arguments) {
+					resolve(a);
+				}
+			}
+		}
+	};
+}
+
+void resolve(Ast &ast, std::unordered_map<Symbol, Intrinsic> const& operators)
+{
+	Resolver resolver { .operators = operators };
+	resolver.resolve(ast);
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+#include <musique/parser/parser.hh>
+#include <musique/value/value.hh>
+
+TEST_CASE("Resolving lexical addresses", "[resolver]")
+{
+	auto ast = Parser::parse("x := 1, fun := (first second | y := first, (say first x y, z := 1, say z))", "test").value();
+	resolve(ast, {});
+
+	auto const& lambda = ast.arguments[1].arguments.back();
+	REQUIRE(lambda.layout);
+	REQUIRE(lambda.layout->names == std::vector<Symbol>{ "first", "second", "y" });
+	REQUIRE(lambda.layout->parameters == std::vector<u32>{ 0, 1 });
+
+	auto const& body = lambda.arguments.back();
+	auto const& y = body.arguments[0].arguments.front();
+	REQUIRE(y.address.frame == lambda.layout.get());
+	REQUIRE(y.address.slot == 2);
+
+	auto const& say = body.arguments[1].arguments.back().arguments[0];
+	REQUIRE(say.arguments[1].address.frame == lambda.layout.get());
+	REQUIRE(say.arguments[1].address.slot == 0);
+	REQUIRE(say.arguments[2].address.frame == nullptr);
+	REQUIRE(say.arguments[3].address.slot == 2);
+
+	auto const& nested_z = body.arguments[1].arguments.back().arguments[2].arguments[1];
+	REQUIRE(nested_z.address.frame == nullptr);
+}
+
+TEST_CASE("Binding operators", "[resolver]")
+{
+	auto const plus = +[](Interpreter&, std::vector<Value>) -> Result<Value> { unreachable(); };
+	std::unordered_map<Symbol, Intrinsic> const operators { { "+", plus } };
+
+	auto ast = Parser::parse("x += 1, 1 + 2, x = 3, x and 4, x - 5, '+", "test").value();
+	resolve(ast, operators);
+
+	REQUIRE(ast.arguments[0].intrinsic == plus);
+	REQUIRE(ast.arguments[0].compound_assignment);
+	REQUIRE(ast.arguments[1].intrinsic == plus);
+	REQUIRE_FALSE(ast.arguments[1].compound_assignment);
+
+	REQUIRE(ast.arguments[2].intrinsic == nullptr);
+	REQUIRE(ast.arguments[3].intrinsic == nullptr);
+	REQUIRE(ast.arguments[4].intrinsic == nullptr);
+	REQUIRE(ast.arguments[5].intrinsic == plus);
+}
+
+#endif
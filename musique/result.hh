@@ -59,7 +59,7 @@ struct [[nodiscard("This value may contain critical error, so it should NOT be i
 				target = location;
 			}
 		}
-		return *this;
+		return std::move(*this);
 	}
 
 	inline tl::expected<T, Error> to_expected() &&
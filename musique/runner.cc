@@ -2,12 +2,15 @@
 #include <iomanip>
 #include <musique/format.hh>
 #include <musique/interpreter/env.hh>
+#include <musique/midi/file.hh>
 #include <musique/parser/parser.hh>
 #include <musique/runner.hh>
 #include <musique/try.hh>
 #include <musique/unicode.hh>
 
 bool dont_automatically_connect = false;
+std::optional<std::string> render_path;
+bool print_timeline = false;
 
 static std::string filename_to_function_name(std::string_view filename);
 
@@ -17,7 +20,13 @@ Runner::Runner()
 	ensure(the == nullptr, "Only one instance of runner is supported");
 	the = this;
 
-	if (!dont_automatically_connect) {
+	if (render_path) {
+		rendering = std::make_shared<midi::File>();
+		interpreter.current_context->port = rendering;
+		interpreter.clock = std::make_unique<Virtual_Clock>(rendering->start);
+	} else if (print_timeline) {
+		interpreter.clock = std::make_unique<Virtual_Clock>();
+	} else if (!dont_automatically_connect) {
 		interpreter.current_context->connect(std::nullopt);
 	}
 
@@ -36,11 +45,12 @@ extern unsigned repl_line_number;
 
 std::optional<Error> Runner::deffered_file(std::string_view source, std::string_view filename)
 {
-	auto ast = Try(Parser::parse(source, filename, repl_line_number));
+	auto ast = std::make_shared<Ast>(Try(Parser::parse(source, filename, repl_line_number)));
+	resolve(*ast, Interpreter::operators);
 	auto name = filename_to_function_name(filename);
 
 	Block block;
-	block.location = ast.location;
+	block.location = ast->location;
 	block.body = std::move(ast);
 	block.context = Env::global;
 	std::cout << "Defined function " << name << " as file " << filename << std::endl;
@@ -60,21 +70,33 @@ std::optional<Error> Runner::run(std::string_view source, std::string_view filen
 		return {};
 	}
 
+	// Tree is freed when evaluation ends, unless blocks created from it are still around
+	auto const tree = std::make_shared<Ast>(std::move(ast));
+	resolve(*tree, Interpreter::operators);
+
 	std::chrono::steady_clock::time_point now;
+
+	// Virtual clock doesn't move between runs, so music of this run continues previous one
+	if (!interpreter.clock->is_virtual()) {
+		interpreter.playback_time.reset();
+	}
 	try {
 		if (holds_alternative<Execution_Options::Time_Execution>(flags)) {
 			now = std::chrono::steady_clock::now();
 		}
 
-		if (auto result = Try(interpreter.eval(std::move(ast))); holds_alternative<Execution_Options::Print_Result>(flags) && not holds_alternative<Nil>(result)) {
+		if (auto result = Try(interpreter.eval(tree, *tree)); holds_alternative<Execution_Options::Print_Result>(flags) && not holds_alternative<Nil>(result)) {
 			std::cout << Try(format(interpreter, result)) << std::endl;
 		}
 	} catch (KeyboardInterrupt const&) {
 		interpreter.turn_off_all_active_notes();
-		interpreter.starter.stop();
 		std::cout << std::endl;
 	}
 
+	if (print_timeline) {
+		static_cast<Virtual_Clock&>(*interpreter.clock).print_timeline(std::cout);
+	}
+
 	if (holds_alternative<Execution_Options::Time_Execution>(flags)) {
 		auto const end = std::chrono::steady_clock::now();
 		std::cout << "(" << std::fixed << std::setprecision(3) << std::chrono::duration_cast<std::chrono::duration<float>>(end - now).count() << " secs)" << std::endl;
@@ -4,6 +4,7 @@
 #include <cstdint>
 #include <musique/bit_field.hh>
 #include <musique/interpreter/interpreter.hh>
+#include <musique/midi/file.hh>
 
 /// Execution_Options is set of flags controlling how Runner executes provided code
 enum class Execution_Options : std::uint32_t
@@ -26,6 +27,9 @@ struct Runner
 	Interpreter interpreter;
 	Execution_Options default_options = static_cast<Execution_Options>(0);
 
+	/// File that music is rendered into instead of being played, when rendering is enabled
+	std::shared_ptr<midi::File> rendering;
+
 	/// Setup interpreter and midi connection with given port
 	Runner();
 
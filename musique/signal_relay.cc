@@ -0,0 +1,74 @@
+#include <musique/signal_relay.hh>
+
+Signal_Relay::Signal_Relay(std::mutex &mutex, std::condition_variable &waiters)
+	: mutex(mutex), waiters(waiters)
+{
+}
+
+Signal_Relay::~Signal_Relay()
+{
+	if (thread.joinable()) {
+		stopping = true;
+		signal();
+		thread.join();
+	}
+}
+
+void Signal_Relay::signal()
+{
+	counter.fetch_add(1, std::memory_order_release);
+	counter.notify_one();
+}
+
+unsigned Signal_Relay::signals() const
+{
+	return counter.load(std::memory_order_acquire);
+}
+
+void Signal_Relay::listen()
+{
+	if (!thread.joinable()) {
+		thread = std::thread([this] { run(); });
+	}
+}
+
+void Signal_Relay::run()
+{
+	for (auto seen = counter.load(std::memory_order_acquire);; seen = counter.load(std::memory_order_acquire)) {
+		// Locking orders signal before waiter's check of its condition, so waiter either sees it or is woken
+		{ std::lock_guard lock(mutex); }
+		waiters.notify_all();
+
+		if (stopping) {
+			return;
+		}
+		counter.wait(seen, std::memory_order_acquire);
+	}
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+
+TEST_CASE("Signal relay wakes up waiters", "[signal]")
+{
+	using namespace std::chrono_literals;
+
+	std::mutex mutex;
+	std::condition_variable waiters;
+	Signal_Relay relay(mutex, waiters);
+	relay.listen();
+
+	auto const seen = relay.signals();
+	std::thread signaller([&relay] {
+		std::this_thread::sleep_for(10ms);
+		relay.signal();
+	});
+
+	std::unique_lock lock(mutex);
+	REQUIRE(waiters.wait_for(lock, 1h, [&] { return relay.signals() != seen; }));
+	lock.unlock();
+	signaller.join();
+}
+
+#endif
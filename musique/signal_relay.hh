@@ -0,0 +1,46 @@
+#ifndef MUSIQUE_SIGNAL_RELAY_HH
+#define MUSIQUE_SIGNAL_RELAY_HH
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/// Wakes threads waiting on condition variable on behalf of signal handlers and realtime callbacks
+///
+/// Those can't lock mutex nor notify condition variable, so signal only increments lock-free counter
+/// and notifies it. Helper thread waits for counter to change and wakes waiters under their mutex,
+/// so wake up that lands between waiter's check of its condition and start of its wait isn't lost.
+struct Signal_Relay
+{
+	/// Relay waking waiters of given condition variable, which must outlive it
+	Signal_Relay(std::mutex &mutex, std::condition_variable &waiters);
+	Signal_Relay(Signal_Relay const&) = delete;
+	Signal_Relay& operator=(Signal_Relay const&) = delete;
+
+	/// Stops helper thread
+	~Signal_Relay();
+
+	/// Wake up waiters. Safe to call from signal handler, doesn't lock and doesn't allocate
+	void signal();
+
+	/// Count of signals so far, so waiter can tell whether any arrived since it started waiting
+	unsigned signals() const;
+
+	/// Start helper thread if it isn't running yet, must be called by waiter before it waits
+	void listen();
+
+private:
+	void run();
+
+	std::mutex &mutex;
+	std::condition_variable &waiters;
+
+	/// Incremented on each signal, helper thread waits for it to change
+	std::atomic<unsigned> counter = 0;
+
+	std::atomic<bool> stopping = false;
+	std::thread thread;
+};
+
+#endif // MUSIQUE_SIGNAL_RELAY_HH
@@ -0,0 +1,67 @@
+#ifndef MUSIQUE_SPSC_QUEUE_HH
+#define MUSIQUE_SPSC_QUEUE_HH
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/// Lock-free bounded queue shared by exactly one producer thread and one consumer thread
+///
+/// Producer only advances tail and consumer only advances head, so neither of them
+/// ever waits for the other one.
+template<typename T, std::size_t Capacity>
+struct Spsc_Queue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity of queue must be a power of two");
+
+	/// Add element at the end of the queue, returns false when queue is full. Producer only.
+	bool push(T const& element)
+	{
+		auto const tail = this->tail.load(std::memory_order_relaxed);
+		if (tail - head.load(std::memory_order_acquire) == Capacity) {
+			return false;
+		}
+		elements[tail % Capacity] = element;
+		this->tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// First element of the queue or nullptr when it's empty. Consumer only.
+	T* front()
+	{
+		return peek(0);
+	}
+
+	/// Element at given offset from the front or nullptr when queue is shorter than that. Consumer only.
+	T* peek(std::size_t offset)
+	{
+		auto const head = this->head.load(std::memory_order_relaxed);
+		if (tail.load(std::memory_order_acquire) - head <= offset) {
+			return nullptr;
+		}
+		return &elements[(head + offset) % Capacity];
+	}
+
+	/// Remove given count of first elements, which must be in the queue. Consumer only.
+	///
+	/// Removed elements stay in their slots until producer overwrites them, so they are released by producer.
+	void pop(std::size_t count = 1)
+	{
+		head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+	}
+
+	/// Count of elements in the queue, may be outdated when it's returned
+	std::size_t size() const
+	{
+		return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+	}
+
+private:
+	std::vector<T> elements = std::vector<T>(Capacity);
+
+	// Indexes are kept in separate cache lines, so threads don't invalidate each other's caches
+	alignas(64) std::atomic<std::size_t> head = 0;
+	alignas(64) std::atomic<std::size_t> tail = 0;
+};
+
+#endif // MUSIQUE_SPSC_QUEUE_HH
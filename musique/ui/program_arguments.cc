@@ -37,6 +37,8 @@ using Parameter         = std::variant<Empty_Argument, Requires_Argument, Define
 extern bool enable_repl;
 extern bool ast_only_mode;
 extern bool dont_automatically_connect;
+extern std::optional<std::string> render_path;
+extern bool print_timeline;
 
 static Defines_Code provide_function = [](std::string_view fname) -> Run {
 	return { .type = Run::Deffered_File, .argument = fname };
@@ -68,6 +70,8 @@ static Requires_Argument show_docs = [](std::string_view builtin) {
 static Empty_Argument set_interactive_mode = [] { enable_repl = true; };
 static Empty_Argument set_ast_only_mode = [] { ast_only_mode = true; };
 static Empty_Argument set_dont_automatically_connect_mode = [] { dont_automatically_connect = true; };
+static Requires_Argument set_render_mode = [](std::string_view path) { render_path = path; };
+static Empty_Argument set_timeline_mode = [] { print_timeline = true; };
 
 
 static Empty_Argument print_version = [] { std::cout << Musique_Version << std::endl; };
@@ -128,6 +132,8 @@ static auto all_parameters = std::array {
 	Entry { "version", print_version },
 	Entry { "v",       print_version },
 
+	Entry { "render", set_render_mode },
+
 	Entry {
 		.name     = "ast",
 		.handler  = set_ast_only_mode,
@@ -139,6 +145,12 @@ static auto all_parameters = std::array {
 		.handler = set_dont_automatically_connect_mode,
 		.internal = true,
 	},
+
+	Entry {
+		.name = "timeline",
+		.handler = set_timeline_mode,
+		.internal = true,
+	},
 };
 
 struct Documentation_For_Handler_Entry
@@ -211,6 +223,23 @@ static auto documentation_for_handler = std::array {
 		.long_documentation =
 			"Prevents automatic connection to MIDI ports. Useful only for enviroments without audio"
 	},
+	Documentation_For_Handler_Entry {
+		.handler = reinterpret_cast<void*>(set_render_mode),
+		.short_documentation = "render music to MIDI file instead of playing it",
+		.long_documentation =
+			"Writes music to given Standard MIDI File instead of playing it. Time doesn't pass\n"
+			"while rendering, so music is written as fast as it can be computed.\n"
+			"When several files are run, given path is a directory where each of them is rendered\n"
+			"by separate worker process, after running code given in arguments."
+	},
+	Documentation_For_Handler_Entry {
+		.handler = reinterpret_cast<void*>(set_timeline_mode),
+		.short_documentation = "play music on virtual clock, printing its timeline",
+		.long_documentation =
+			"Parameter made for internal usage. Music is played on virtual clock that doesn't wait,\n"
+			"and after each run all MIDI messages sent by it are printed with time they were sent at.\n"
+			"Makes timing of music testable and repeatable."
+	},
 	Documentation_For_Handler_Entry {
 		.handler = reinterpret_cast<void*>(print_manpage),
 		.short_documentation = "print man page source code to standard output",
@@ -13,49 +13,98 @@ static inline std::optional<Error> guard_index(unsigned index, unsigned size)
 	};
 }
 
+Block Block::from(std::shared_ptr<Ast const> const& tree, Ast const& ast, std::shared_ptr<Env> context)
+{
+	Block block;
+	if (ast.type == Ast::Type::Lambda) {
+		auto parameters = std::span(ast.arguments).subspan(0, ast.arguments.size() - 1);
+		block.parameters.reserve(parameters.size());
+		for (auto const& param : parameters) {
+			ensure(param.type == Ast::Type::Literal && param.token.type == Token::Type::Symbol, "Not a name in parameter section of Ast::lambda");
+			block.parameters.push_back(param.symbol);
+		}
+		block.layout = ast.layout.get();
+	}
+
+	block.context = std::move(context);
+	block.body = std::shared_ptr<Ast const>(tree, &ast.arguments.back());
+	return block;
+}
+
 // TODO Add memoization
 Result<Value> Block::index(Interpreter &i, unsigned position) const
 {
 	ensure(parameters.empty(), "cannot index into block with parameters (for now)");
-	if (body.type != Ast::Type::Sequence) {
+	if (body->type != Ast::Type::Sequence) {
 		Try(guard_index(position, 1));
-		return i.eval((Ast)body);
+		return i.eval(body, *body);
 	}
 
-	Try(guard_index(position, body.arguments.size()));
-	return i.eval((Ast)body.arguments[position]);
+	Try(guard_index(position, body->arguments.size()));
+	return i.eval(body, body->arguments[position]);
 }
 
 usize Block::size() const
 {
-	return body.type == Ast::Type::Sequence ? body.arguments.size() : 1;
+	return body->type == Ast::Type::Sequence ? body->arguments.size() : 1;
 }
 
 Result<Value> Block::operator()(Interpreter &i, std::vector<Value> arguments) const
 {
-	auto old_scope = std::exchange(i.env, context);
-	i.enter_scope();
+	// Calls in tail position of body are performed by this loop instead of recursion,
+	// reusing frame of previous call when nothing captured it
+	Block const* block = this;
+	Value callee;
+	std::shared_ptr<Env> frame;
+	std::optional<Location> call_location;
 
-	if (parameters.size() > arguments.size()) {
-		return errors::Wrong_Arity_Of {
-			.type = errors::Wrong_Arity_Of::Function,
-			 // TODO Let user defined functions have name of their first assigment (Zig like)
-			 //      or from place of definition like <block at file:line:column>
-			.name = "<block>",
-			.expected_arity = parameters.size(),
-			.actual_arity = arguments.size(),
-		};
-	}
+	for (;;) {
+		if (block->parameters.size() > arguments.size()) {
+			return Error {
+				.details = errors::Wrong_Arity_Of {
+					.type = errors::Wrong_Arity_Of::Function,
+					 // TODO Let user defined functions have name of their first assigment (Zig like)
+					 //      or from place of definition like <block at file:line:column>
+					.name = "<block>",
+					.expected_arity = block->parameters.size(),
+					.actual_arity = arguments.size(),
+				},
+				.location = call_location,
+			};
+		}
 
-	for (usize j = 0; j < std::min(parameters.size(), arguments.size()); ++j) {
-		i.env->force_define(parameters[j], std::move(arguments[j]));
-	}
+		if (frame.use_count() == 1 && frame->parent == block->context && frame->layout == block->layout) {
+			frame->variables.clear();
+			std::fill(frame->slots.begin(), frame->slots.end(), std::nullopt);
+		} else {
+			frame = block->context->enter(block->layout);
+		}
+
+		for (usize j = 0; j < std::min(block->parameters.size(), arguments.size()); ++j) {
+			if (block->layout) {
+				frame->slots[block->layout->parameters[j]] = std::move(arguments[j]);
+			} else {
+				frame->force_define(block->parameters[j], std::move(arguments[j]));
+			}
+		}
 
-	Ast body_copy = body;
-	auto result = i.eval(std::move(body_copy));
+		auto old_scope = std::exchange(i.env, frame);
+		auto result = i.eval(block->body, *block->body, true);
+		i.env = std::move(old_scope);
 
-	i.env = old_scope;
-	return result;
+		if (call_location) {
+			result = std::move(result).with_location(*call_location);
+		}
+		if (!result.has_value() || !i.tail_call) {
+			return result;
+		}
+
+		auto next = *std::exchange(i.tail_call, std::nullopt);
+		callee = std::move(next.function);
+		arguments = std::move(next.arguments);
+		call_location = next.location;
+		block = get_if<Block>(callee);
+	}
 }
 
 bool Block::is_collection() const
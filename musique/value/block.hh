@@ -6,6 +6,7 @@
 #include <musique/result.hh>
 #include <musique/value/collection.hh>
 #include <musique/value/function.hh>
+#include <musique/value/symbol.hh>
 
 struct Env;
 struct Interpreter;
@@ -16,14 +17,23 @@ struct Block : Collection, Function
 {
 	~Block() override = default;
 
+	/// Create block from Ast::Type::Block or Ast::Type::Lambda node of given tree, capturing given context
+	static Block from(std::shared_ptr<Ast const> const& tree, Ast const& ast, std::shared_ptr<Env> context);
+
 	/// Location of definition / creation
 	Location location;
 
 	/// Names of expected parameters
-	std::vector<std::string> parameters;
+	std::vector<Symbol> parameters;
+
+	/// Layout of frame created for each call, nullptr when block has no parameters
+	Frame_Layout const* layout = nullptr;
 
 	/// Body that will be executed
-	Ast body;
+	///
+	/// Points into program tree that created this block and shares ownership of whole tree,
+	/// so calling a block never copies its body and tree is freed with its last block.
+	std::shared_ptr<Ast const> body;
 
 	/// Context from which block was created. Used for closures
 	std::shared_ptr<Env> context;
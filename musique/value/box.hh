@@ -0,0 +1,75 @@
+#ifndef MUSIQUE_VALUE_BOX_HH
+#define MUSIQUE_VALUE_BOX_HH
+
+#include <memory>
+#include <type_traits>
+
+/// Reference counted pointer to object that is too big to be stored inline in Value
+///
+/// Copies of box share the same object, so copying is O(1). Object is read through get(),
+/// which never copies it. Code that mutates it calls unshare() first, which makes a private
+/// copy of shared object, so boxed objects behave like values.
+template<typename T>
+struct Box
+{
+	Box(T &&object)
+		: shared(std::make_shared<T>(std::move(object)))
+	{
+	}
+
+	Box(T const& object)
+		: shared(std::make_shared<T>(object))
+	{
+	}
+
+	/// Read only access to boxed object, shared or not
+	T const& get() const { return *shared; }
+
+	T const& operator*() const { return *shared; }
+	T const* operator->() const { return shared.get(); }
+
+	/// Make sure that this box is the only owner of its object and return it for mutation
+	T* unshare()
+	{
+		if (shared.use_count() > 1) {
+			shared = std::make_shared<T>(*shared);
+		}
+		return shared.get();
+	}
+
+	/// Whether both boxes point to the same object
+	bool shares_with(Box const& other) const
+	{
+		return shared == other.shared;
+	}
+
+private:
+	std::shared_ptr<T> shared;
+};
+
+template<typename T>
+struct Unboxed { using type = T; };
+
+template<typename T>
+struct Unboxed<Box<T>> { using type = T; };
+
+/// Type of object stored in Value alternative T
+template<typename T>
+using Unboxed_t = typename Unboxed<std::remove_cvref_t<T>>::type;
+
+/// Return object held by box or given object if it is not a box
+///
+/// Objects of boxes are returned as read only, unless box is rvalue that object can be moved from.
+template<typename T>
+constexpr decltype(auto) unbox(T &&object)
+{
+	if constexpr (std::is_same_v<Unboxed_t<T>, std::remove_cvref_t<T>>) {
+		return std::forward<T>(object);
+	} else if constexpr (std::is_rvalue_reference_v<T&&> && !std::is_const_v<std::remove_reference_t<T>>) {
+		return std::move(*object.unshare());
+	} else {
+		return object.get();
+	}
+}
+
+#endif // MUSIQUE_VALUE_BOX_HH
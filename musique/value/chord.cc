@@ -95,7 +95,7 @@ Result<Value> Chord::operator()(Interpreter& interpreter, std::vector<Value> arg
 			continue;
 		}
 
-		if (auto chord = get_if<Chord>(arg)) {
+		if (auto chord = unshare<Chord>(arg)) {
 			std::transform(current.begin(), current.end(), std::back_inserter(array),
 				[](Chord &c) { return std::move(c); });
 			current.clear();
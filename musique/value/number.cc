@@ -5,6 +5,62 @@
 #include <numeric>
 #include <charconv>
 
+/// Intermediate type of arithmetic, wide enough to hold product of any two numerators or denominators
+using Wide = __int128;
+
+/// Fractions with numerator or denominator above this magnitude are reduced after each operation
+static constexpr Wide Reduce_Above = Wide(1) << 32;
+
+static constexpr Wide Max = std::numeric_limits<Number::value_type>::max();
+
+/// Only number that value_type can hold but Number can't, since it has no negation
+static constexpr Number::value_type Min = std::numeric_limits<Number::value_type>::min();
+
+/// Greatest common divisor of wide integers, std::gcd doesn't accept them in strict standard mode
+static Wide gcd(Wide a, Wide b)
+{
+	if (a < 0) a = -a;
+	if (b < 0) b = -b;
+	while (b > Max || a > Max) {
+		a = std::exchange(b, a % b);
+		if (b == 0) return a;
+	}
+	return std::gcd(Number::value_type(a), Number::value_type(b));
+}
+
+/// Create number from result of wide arithmetic
+///
+/// Fraction is reduced only when it's getting big, so sequences of operations on fractions
+/// usually do one gcd when result is observed instead of one for every operation.
+/// Results that don't fit in value_type even after reduction are reported as overflow.
+static Result<Number> from_wide(Wide num, Wide den)
+{
+	if (den < 0) {
+		num = -num;
+		den = -den;
+	}
+
+	if (den != 1 && (num > Reduce_Above || num < -Reduce_Above || den > Reduce_Above)) {
+		if (auto const d = gcd(num, den); d > 1) {
+			num /= d;
+			den /= d;
+		}
+	}
+
+	if (num > Max || num < -Max || den > Max) {
+		return Error {
+			.details = errors::Arithmetic {
+				.type = errors::Arithmetic::Overflow
+			}
+		};
+	}
+
+	Number result;
+	result.num = Number::value_type(num);
+	result.den = Number::value_type(den);
+	return result;
+}
+
 Number::Number(value_type v)
 	: num(v), den(1)
 {
@@ -13,6 +69,11 @@ Number::Number(value_type v)
 Number::Number(value_type num, value_type den)
 	: num(num), den(den)
 {
+	if (den < 0) {
+		ensure(num != Min && den != Min, "Negation of fraction doesn't fit in numbers");
+		this->num = -num;
+		this->den = -den;
+	}
 }
 
 auto Number::as_int() const -> i64
@@ -33,13 +94,15 @@ auto Number::simplify() const -> Number
 // TODO This function may behave weirdly for maximum & minimum values of i64
 void Number::simplify_inplace()
 {
-	for (;;) {
-		if (auto d = std::gcd(num, den); d != 1) {
-			num /= d;
-			den /= d;
-		} else {
-			break;
-		}
+	// Integers are the most common numbers and are always simplified
+	if (den == 1) {
+		return;
+	}
+
+	// After division by gcd numerator and denominator are coprime
+	if (auto d = std::gcd(num, den); d != 1 && d != 0) {
+		num /= d;
+		den /= d;
 	}
 
 	if (den < 0) {
@@ -52,7 +115,10 @@ void Number::simplify_inplace()
 
 bool Number::operator==(Number const& rhs) const
 {
-	return (*this <=> rhs) == 0;
+	if (den == rhs.den) {
+		return num == rhs.num;
+	}
+	return Wide(num) * rhs.den == Wide(rhs.num) * den;
 }
 
 bool Number::operator!=(Number const& rhs) const
@@ -62,50 +128,42 @@ bool Number::operator!=(Number const& rhs) const
 
 std::strong_ordering Number::operator<=>(Number const& rhs) const
 {
-	return (num * rhs.den - den * rhs.num) <=> 0;
-}
-
-Number Number::operator+(Number const& rhs) const
-{
-	int dens_lcm = std::lcm(den, rhs.den);
-  	return Number{(num * (dens_lcm / den)) + (rhs.num * (dens_lcm / rhs.den)), dens_lcm}.simplify();
+	if (den == rhs.den) {
+		return num <=> rhs.num;
+	}
+	return Wide(num) * rhs.den <=> Wide(rhs.num) * den;
 }
 
-Number& Number::operator+=(Number const& rhs)
+Result<Number> Number::operator+(Number const& rhs) const
 {
-	int dens_lcm = std::lcm(den, rhs.den);
-   	num = (num * (dens_lcm / den)) + (rhs.num * (dens_lcm / rhs.den));
-   	den = dens_lcm;
-   	simplify_inplace();
-   	return *this;
-}
+	if (value_type sum; den == 1 && rhs.den == 1 && !__builtin_add_overflow(num, rhs.num, &sum) && sum != Min) {
+		return Number(sum);
+	}
 
-Number Number::operator-(Number const& rhs) const
-{
-	int dens_lcm = std::lcm(den, rhs.den);
-  	return Number{(num * (dens_lcm / den)) - (rhs.num * (dens_lcm / rhs.den)), dens_lcm}.simplify();
+	if (den == rhs.den) {
+		return from_wide(Wide(num) + rhs.num, den);
+	}
+	return from_wide(Wide(num) * rhs.den + Wide(rhs.num) * den, Wide(den) * rhs.den);
 }
 
-Number& Number::operator-=(Number const& rhs)
+Result<Number> Number::operator-(Number const& rhs) const
 {
-	int dens_lcm = std::lcm(den, rhs.den);
-   	num = (num * (dens_lcm / den)) - (rhs.num * (dens_lcm / rhs.den));
-   	den = dens_lcm;
-   	simplify_inplace();
-   	return *this;
-}
+	if (value_type difference; den == 1 && rhs.den == 1 && !__builtin_sub_overflow(num, rhs.num, &difference) && difference != Min) {
+		return Number(difference);
+	}
 
-Number Number::operator*(Number const& rhs) const
-{
-  	return Number{num * rhs.num, den * rhs.den}.simplify();
+	if (den == rhs.den) {
+		return from_wide(Wide(num) - rhs.num, den);
+	}
+	return from_wide(Wide(num) * rhs.den - Wide(rhs.num) * den, Wide(den) * rhs.den);
 }
 
-Number& Number::operator*=(Number const& rhs)
+Result<Number> Number::operator*(Number const& rhs) const
 {
-   	num *= rhs.num;
-   	den *= rhs.den;
-   	simplify_inplace();
-   	return *this;
+	if (value_type product; den == 1 && rhs.den == 1 && !__builtin_mul_overflow(num, rhs.num, &product) && product != Min) {
+		return Number(product);
+	}
+	return from_wide(Wide(num) * rhs.num, Wide(den) * rhs.den);
 }
 
 Result<Number> Number::operator/(Number const& rhs) const
@@ -117,7 +175,11 @@ Result<Number> Number::operator/(Number const& rhs) const
 			}
 		};
 	}
-	return Number{num * rhs.den, den * rhs.num}.simplify();
+	// Min / -1 overflows and traps, so it goes through from_wide which reports it
+	if (den == 1 && rhs.den == 1 && num != Min && num % rhs.num == 0) {
+		return Number(num / rhs.num);
+	}
+	return from_wide(Wide(num) * rhs.den, Wide(den) * rhs.num);
 }
 
 inline auto modular_inverse(Number::value_type a, Number::value_type n)
@@ -176,8 +238,9 @@ Result<Number> Number::operator%(Number const& rhs) const
 	);
 }
 
-std::ostream& operator<<(std::ostream& os, Number const& n)
+std::ostream& operator<<(std::ostream& os, Number const& number)
 {
+	auto const n = number.simplify();
 	return n.den == 1
 		? os << n.num
 		: os << n.num << '/' << n.den;
@@ -242,7 +305,7 @@ parse_fractional:
 				.location = std::move(token.location)
 			};
 		}
-		result += Number{ (result.num < 0 ? -1 : 1) * frac, pow10(frac_end - num_end) };
+		result = Try(result + Number((result.num < 0 ? -1 : 1) * frac, pow10(frac_end - num_end)));
 	}
 
 	return result.simplify();
@@ -306,7 +369,7 @@ Result<Number> Number::inverse() const
 			}
 		};
 	}
-	return { den, num };
+	return from_wide(den, num);
 }
 
 namespace impl
@@ -322,8 +385,7 @@ namespace impl
 		auto flip = false;
 		if (n < 0) { flip = true; n = -n; }
 
-		for (auto i = n; i != 0; --i) result.num *= x.num;
-		for (auto i = n; i != 0; --i) result.den *= x.den;
+		for (auto i = n; i != 0; --i) result = Try(result * x);
 		return flip ? Try(result.inverse()) : result;
 	}
 }
@@ -334,7 +396,7 @@ Result<Number> Number::pow(Number n) const
 
 	// Simple case, we raise this to integer power.
 	if (n.den == 1) {
-		return impl::pow(*this, n.num);
+		return impl::pow(simplify(), n.num);
 	}
 
 	// Hard case, we raise this to fractional power.
@@ -343,8 +405,10 @@ Result<Number> Number::pow(Number n) const
 	unimplemented("nth root calculation is not implemented yet");
 }
 
-std::size_t std::hash<Number>::operator()(Number const& value) const
+std::size_t std::hash<Number>::operator()(Number const& number) const
 {
+	// Equal numbers must have equal hashes, regardless of how much they are reduced
+	auto const value = number.simplify();
 	std::hash<Number::value_type> h;
 	return hash_combine(h(value.num), h(value.den));
 }
@@ -352,6 +416,7 @@ std::size_t std::hash<Number>::operator()(Number const& value) const
 #ifdef MUSIQUE_UNIT_TESTING
 
 #include <catch_amalgamated.hpp>
+#include <sstream>
 
 TEST_CASE("Number arithmetic operators", "[number]")
 {
@@ -361,6 +426,73 @@ TEST_CASE("Number arithmetic operators", "[number]")
 	REQUIRE(Number{1, 8} / Number{3, 4} == Number{ 1,  6});
 }
 
+TEST_CASE("Number arithmetic on integers", "[number]")
+{
+	REQUIRE(Number(6) + Number(-8) == Number(-2));
+	REQUIRE(Number(6) - Number(8)  == Number(-2));
+	REQUIRE(Number(6) * Number(-8) == Number(-48));
+	REQUIRE(Number(6) / Number(3)  == Number(2));
+	REQUIRE(Number(6) / Number(4)  == Number(3, 2));
+	REQUIRE(Number(-6) / Number(4) == Number(-3, 2));
+	REQUIRE((Number(6) / Number(-4))->den > 0);
+	REQUIRE(Number(1, 2) + Number(1, 2) == Number(1));
+	REQUIRE((Number(1, 2) + Number(1, 2))->simplify().den == 1);
+	REQUIRE(Number(3) < Number(4));
+	REQUIRE(Number(-3, 2) < Number(-1));
+
+	// Denominators that don't fit in int
+	constexpr Number::value_type big = Number::value_type(1) << 40;
+	REQUIRE(Number(1, big) + Number(1, big) == Number(1, big / 2));
+	REQUIRE(Number(1, big) - Number(1, big / 2) == Number(-1, big));
+}
+
+TEST_CASE("Lazily reduced numbers", "[number]")
+{
+	auto const unreduced = *(Number(1, 4) + Number(1, 4));
+	REQUIRE(unreduced == Number(1, 2));
+	REQUIRE(std::hash<Number>{}(unreduced) == std::hash<Number>{}(Number(1, 2)));
+	REQUIRE((std::stringstream{} << unreduced).str() == "1/2");
+	REQUIRE(Number(2, -4) < Number(0));
+
+	// Intermediate results that don't fit in 64 bits
+	constexpr Number::value_type big = Number::value_type(1) << 40;
+	REQUIRE(Number(big, 3) * Number(3, big) == Number(1));
+	REQUIRE(Number(1, big) < Number(big, 3));
+	REQUIRE(Number(-big, 3) < Number(-1, big));
+
+	// Long sums of durations stay exact
+	auto total = Number(0);
+	for (int i = 0; i < 1000; ++i) {
+		total = *(total + Number(1, 12));
+		total = *(total + Number(3, 32));
+		total = *(total + Number(7, 48));
+	}
+	REQUIRE(total == Number(1000 * 31, 96));
+}
+
+TEST_CASE("Numbers that don't fit are reported", "[number]")
+{
+	constexpr auto max = std::numeric_limits<Number::value_type>::max();
+	constexpr Number::value_type big = Number::value_type(1) << 40;
+
+	REQUIRE(!(Number(max) + Number(1)).has_value());
+	REQUIRE(!(Number(-max) - Number(2)).has_value());
+	REQUIRE(!(Number(big) * Number(big)).has_value());
+	REQUIRE(!(Number(1, big) * Number(1, big)).has_value());
+	REQUIRE(!Number(2).pow(Number(64)).has_value());
+
+	// Smallest 64 bit integer has no negation, so it's reported instead of trapping
+	REQUIRE(!(Number(-max) - Number(1)).has_value());
+	REQUIRE(!(Number(-max) + Number(-1)).has_value());
+	REQUIRE(!(Number(-(max / 2) - 1) * Number(2)).has_value());
+	REQUIRE(!(Number(-max) / Number(-1, 2)).has_value());
+	REQUIRE(Number(-max) / Number(-1) == Number(max));
+
+	// Results that fit after reduction are fine
+	REQUIRE(Number(max, 2) + Number(max, 2) == Number(max));
+	REQUIRE(Number(max) - Number(1) == Number(max - 1));
+}
+
 
 TEST_CASE("Number::floor()", "[number]")
 {
@@ -8,7 +8,11 @@
 
 /// Number type supporting integer and fractional constants
 ///
-/// \invariant gcd(num, den) == 1, after any operation
+/// Arithmetic is computed with 128 bit intermediates and its results are reduced only when
+/// they get big, so fraction may not be in lowest terms. Comparison, hashing and printing
+/// don't depend on it, code reading num and den directly should use simplify() first.
+///
+/// \invariant den > 0
 struct Number
 {
 	/// Type that represents numerator and denominator values
@@ -34,12 +38,9 @@ struct Number
 	bool operator!=(Number const&) const;
 	std::strong_ordering operator<=>(Number const&) const;
 
-	Number  operator+(Number const& rhs) const;
-	Number& operator+=(Number const& rhs);
-	Number  operator-(Number const& rhs) const;
-	Number& operator-=(Number const& rhs);
-	Number  operator*(Number const& rhs) const;
-	Number& operator*=(Number const& rhs);
+	Result<Number> operator+(Number const& rhs) const;
+	Result<Number> operator-(Number const& rhs) const;
+	Result<Number> operator*(Number const& rhs) const;
 	Result<Number> operator/(Number const& rhs) const;
 	Result<Number> operator%(Number const& rhs) const;
 
@@ -0,0 +1,88 @@
+#include <musique/value/symbol.hh>
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+	/// Storage of all interned symbols, never freed
+	struct Symbol_Table
+	{
+		std::mutex mutex;
+		std::deque<std::string> texts;
+		std::unordered_map<std::string_view, std::string const*> index;
+
+		std::string const* intern(std::string_view text)
+		{
+			std::lock_guard guard{mutex};
+			if (auto it = index.find(text); it != index.end()) {
+				return it->second;
+			}
+			auto const& stored = texts.emplace_back(text);
+			index.emplace(stored, &stored);
+			return &stored;
+		}
+
+		static Symbol_Table& get()
+		{
+			static Symbol_Table table;
+			return table;
+		}
+	};
+}
+
+Symbol::Symbol()
+	: Symbol(std::string_view{})
+{
+}
+
+Symbol::Symbol(std::string_view text)
+	: text(Symbol_Table::get().intern(text))
+{
+}
+
+Symbol::Symbol(std::string const& text)
+	: Symbol(std::string_view(text))
+{
+}
+
+Symbol::Symbol(char const* text)
+	: Symbol(std::string_view(text))
+{
+}
+
+std::strong_ordering Symbol::operator<=>(Symbol const& rhs) const
+{
+	if (text == rhs.text) {
+		return std::strong_ordering::equal;
+	}
+	if (auto cmp = text->size() <=> rhs.text->size(); cmp != 0) {
+		return cmp;
+	}
+	return *text <=> *rhs.text;
+}
+
+std::ostream& operator<<(std::ostream& os, Symbol const& symbol)
+{
+	return os << symbol.view();
+}
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+
+TEST_CASE("Symbol interning", "[symbol]")
+{
+	std::string dynamic = "foo";
+	REQUIRE(Symbol("foo") == Symbol(dynamic));
+	REQUIRE(Symbol("foo").text == Symbol(std::string_view(dynamic)).text);
+	REQUIRE(Symbol("foo") != Symbol("bar"));
+	REQUIRE(Symbol().view().empty());
+	REQUIRE(Symbol() == Symbol(""));
+
+	REQUIRE(Symbol("zz") < Symbol("aaa"));
+	REQUIRE(Symbol("ab") < Symbol("ba"));
+}
+
+#endif
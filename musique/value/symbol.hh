@@ -0,0 +1,39 @@
+#ifndef MUSIQUE_VALUE_SYMBOL_HH
+#define MUSIQUE_VALUE_SYMBOL_HH
+
+#include <compare>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/// Interned string used for identifiers, symbol values and operator names
+///
+/// Each distinct text is stored once for the whole program lifetime and symbol
+/// is only a handle to it, so copying, equality and hashing are trivial.
+struct Symbol
+{
+	/// Creates empty symbol
+	Symbol();
+
+	/// Interns given text
+	Symbol(std::string_view text);
+	Symbol(std::string const& text);
+	Symbol(char const* text);
+
+	/// Text of symbol, valid for the whole program lifetime
+	inline std::string_view view() const { return *text; }
+
+	inline bool operator==(Symbol const& rhs) const { return text == rhs.text; }
+
+	/// Orders symbols like strings: shorter first, then lexicographically
+	std::strong_ordering operator<=>(Symbol const& rhs) const;
+
+	std::string const* text;
+};
+
+std::ostream& operator<<(std::ostream& os, Symbol const& symbol);
+
+template<> struct std::hash<Symbol> { std::size_t operator()(Symbol const& s) const { return std::hash<void const*>{}(s.text); } };
+
+#endif // MUSIQUE_VALUE_SYMBOL_HH
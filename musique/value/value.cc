@@ -9,25 +9,9 @@
 #include <iostream>
 #include <numeric>
 #include <compare>
-#include <cstring>
 
 Value::Value() = default;
 
-std::strong_ordering operator<=>(std::string const& lhs, std::string const& rhs)
-{
-	if (auto cmp = lhs.size() <=> rhs.size(); cmp == 0) {
-		if (auto cmp = std::strncmp(lhs.c_str(), rhs.c_str(), lhs.size()); cmp == 0) {
-			return std::strong_ordering::equal;
-		} else if (cmp < 0) {
-			return std::strong_ordering::less;
-		} else {
-			return std::strong_ordering::greater;
-		}
-	} else {
-		return cmp;
-	}
-}
-
 Result<Value> Value::from(Token t)
 {
 	switch (t.type) {
@@ -68,7 +52,7 @@ Value::Value(Number n)
 }
 
 Value::Value(std::string s)
-	: data(Symbol(std::move(s)))
+	: data(Symbol(s))
 {
 }
 
@@ -82,28 +66,33 @@ Value::Value(char const* s)
 {
 }
 
+Value::Value(Symbol s)
+	: data(s)
+{
+}
+
 Value::Value(Block &&block)
-	: data{std::move(block)}
+	: data(Box<Block>(std::move(block)))
 {
 }
 
 Value::Value(Array &&array)
-	: data{std::move(array)}
+	: data(Box<Array>(std::move(array)))
 {
 }
 
 Value::Value(std::vector<Value> &&array)
-	: data(Array(std::move(array)))
+	: data(Box<Array>(Array(std::move(array))))
 {
 }
 
 Value::Value(Note n)
-	: data(Chord(n))
+	: data(Box<Chord>(Chord(n)))
 {
 }
 
 Value::Value(Chord chord)
-	: data(std::move(chord))
+	: data(Box<Chord>(std::move(chord)))
 {
 }
 
@@ -128,7 +117,7 @@ Result<Value> Value::index(Interpreter &i, unsigned position) const
 
 bool Value::truthy() const
 {
-	return std::visit(Overloaded {
+	return visit_unboxed(Overloaded {
 		[](Bool b)          { return b; },
 		[](Nil)             { return false; },
 		[](Number const& n) { return n != Number(0); },
@@ -145,7 +134,7 @@ bool Value::falsy() const
 
 bool Value::operator==(Value const& other) const
 {
-	return std::visit(Overloaded {
+	return visit_unboxed(Overloaded {
 		[]<typename T>(T const& lhs, T const& rhs) -> bool requires (!std::is_same_v<T, Block>) {
 			return lhs == rhs;
 		},
@@ -166,7 +155,7 @@ usize Value::size() const
 std::partial_ordering Value::operator<=>(Value const& rhs) const
 {
 	// TODO Block - array comparison should be allowed
-	return std::visit(Overloaded {
+	return visit_unboxed(Overloaded {
 		[](Nil, Nil) { return std::partial_ordering::equivalent; },
 		[](Array const& lhs, Array const& rhs) {
 			return algo::lexicographical_compare(lhs.elements, rhs.elements);
@@ -183,7 +172,7 @@ std::partial_ordering Value::operator<=>(Value const& rhs) const
 
 std::ostream& operator<<(std::ostream& os, Value const& v)
 {
-	std::visit(Overloaded {
+	visit_unboxed(Overloaded {
 		[&](Bool b) { os << std::boolalpha << b; },
 		[&](Nil)    { os << "nil"; },
 		[&](Intrinsic) { os << "<intrinisic>"; },
@@ -196,7 +185,7 @@ std::ostream& operator<<(std::ostream& os, Value const& v)
 
 std::string_view type_name(Value const& v)
 {
-	return std::visit(Overloaded {
+	return visit_unboxed(Overloaded {
 		[&](Array const&)     { return "array"; },
 		[&](Block const&)     { return "block"; },
 		[&](Bool const&)      { return "bool"; },
@@ -230,10 +219,10 @@ Result<std::vector<Value>> flatten(Interpreter &i, std::vector<Value> args)
 
 std::size_t std::hash<Value>::operator()(Value const& value) const
 {
-	auto const value_hash = std::visit(Overloaded {
+	auto const value_hash = visit_unboxed(Overloaded {
 		[](Nil) { return std::size_t(0); },
 		[](Intrinsic i) { return size_t(i.function_pointer); },
-		[](Block const& b) { return hash_combine(std::hash<Ast>{}(b.body), b.parameters.size()); },
+		[](Block const& b) { return hash_combine(std::hash<Ast>{}(*b.body), b.parameters.size()); },
 		[this](Array const& array) {
 			return std::accumulate(
 				array.elements.begin(), array.elements.end(), size_t(0),
@@ -253,3 +242,69 @@ std::size_t std::hash<Value>::operator()(Value const& value) const
 
 	return hash_combine(value_hash, size_t(value.data.index()));
 }
+
+#ifdef MUSIQUE_UNIT_TESTING
+
+#include <catch_amalgamated.hpp>
+
+// Number is two 64 bit integers, so it sets lower bound for Value size
+static_assert(sizeof(Value) <= sizeof(Number) + sizeof(void*));
+
+TEST_CASE("Boxed values", "[value]")
+{
+	Value const original(std::vector<Value>{ Number(1), Number(2) });
+	Value copy = original;
+	REQUIRE(std::get<Box<Array>>(copy.data).shares_with(std::get<Box<Array>>(original.data)));
+
+	unshare<Array>(copy)->elements.push_back(Number(3));
+	REQUIRE(original.size() == 2);
+	REQUIRE(copy.size() == 3);
+	REQUIRE(!std::get<Box<Array>>(copy.data).shares_with(std::get<Box<Array>>(original.data)));
+
+	REQUIRE(get_if<Collection>(original) != nullptr);
+	REQUIRE(original != copy);
+}
+
+TEST_CASE("Arrays are copied on write", "[value]")
+{
+	Value array(std::vector<Value>(1000, Value(Number(1))));
+	auto const& storage = std::get<Box<Array>>(array.data);
+	Value copy = array;
+
+	// Reading through interfaces, accessors and match doesn't copy elements
+	REQUIRE(get_if<Collection>(copy)->size() == 1000);
+	REQUIRE(get_if<Array>(copy)->elements.size() == 1000);
+	REQUIRE(get_if<Array>(std::as_const(copy))->elements.size() == 1000);
+	REQUIRE(std::get<0>(*match<Array, Value>(copy, array)).elements.size() == 1000);
+	REQUIRE(std::get<Box<Array>>(copy.data).shares_with(storage));
+	REQUIRE(copy == array);
+
+	// Only the mutated copy gets its own storage
+	unshare<Array>(copy)->elements[0] = Number(2);
+	REQUIRE(!std::get<Box<Array>>(copy.data).shares_with(storage));
+	REQUIRE(get_if<Array>(std::as_const(array))->elements[0] == Value(Number(1)));
+	REQUIRE(copy != array);
+	REQUIRE(type_name(Value(Note{})) == "music");
+}
+
+TEST_CASE("Value layout", "[.][benchmark]")
+{
+	// Layout of Value before heavy alternatives were boxed
+	using Unboxed_Value = std::variant<Nil, Bool, Number, Symbol, Intrinsic, Block, Array, Chord, Macro>;
+
+	constexpr usize elements = 10'000;
+	WARN("Footprint of " << elements << " element array: "
+		<< elements * sizeof(Value) << " bytes, was " << elements * sizeof(Unboxed_Value) << " bytes");
+
+	std::vector<Value> numbers(elements, Value(Number(1, 3)));
+	std::vector<Unboxed_Value> unboxed_numbers(elements, Number(1, 3));
+	std::vector<Value> arrays(elements, Value(std::vector<Value>(8, Value(Number(1)))));
+	std::vector<Unboxed_Value> unboxed_arrays(elements, Array(std::vector<Value>(8, Value(Number(1)))));
+
+	BENCHMARK("Copy array of numbers") { return std::vector<Value>(numbers); };
+	BENCHMARK("Copy array of numbers, unboxed") { return std::vector<Unboxed_Value>(unboxed_numbers); };
+	BENCHMARK("Copy array of arrays") { return std::vector<Value>(arrays); };
+	BENCHMARK("Copy array of arrays, unboxed") { return std::vector<Unboxed_Value>(unboxed_arrays); };
+}
+
+#endif
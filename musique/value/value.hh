@@ -7,21 +7,24 @@
 #include <musique/result.hh>
 #include <musique/value/array.hh>
 #include <musique/value/block.hh>
+#include <musique/value/box.hh>
 #include <musique/value/chord.hh>
 #include <musique/value/intrinsic.hh>
 #include <musique/value/note.hh>
+#include <musique/value/symbol.hh>
 
 struct Nil
 {
 	bool operator==(Nil const&) const = default;
 };
 
-using Bool   = bool;
-using Symbol = std::string;
+using Bool = bool;
 
-using Macro = Result<Value>(*)(Interpreter &i, std::span<Ast>);
+using Macro = Result<Value>(*)(Interpreter &i, std::span<Ast const>);
 
 /// Representation of any value in language
+///
+/// Alternatives bigger than Number are boxed, so Value stays small and cheap to copy.
 struct Value
 {
 	/// Creates value from literal contained in Token
@@ -40,21 +43,18 @@ struct Value
 	Value(char const* s);              ///< Create value of type symbol holding provided symbol
 	Value(std::string s);              ///< Create value of type symbol holding provided symbol
 	Value(std::string_view s);         ///< Create value of type symbol holding provided symbol
+	Value(Symbol s);                   ///< Create value of type symbol holding provided symbol
 	explicit Value(std::vector<Value> &&array); ///< Create value of type array holding provided array
 
-	// TODO Most strings should not be allocated by Value, but reference to string allocated previously
-	// Wrapper for std::string is needed that will allocate only when needed, middle ground between:
-	//   std::string      - always owning string type
-	//   std::string_view - not-owning string type
 	std::variant<
 		Nil,
 		Bool,
 		Number,
 		Symbol,
 		Intrinsic,
-		Block,
-		Array,
-		Chord,
+		Box<Block>,
+		Box<Array>,
+		Box<Chord>,
 		Macro
 	> data = Nil{};
 
@@ -98,12 +98,32 @@ struct Value
 	std::partial_ordering operator<=>(Value const& other) const;
 };
 
+/// Type through which alternative T of Value is accessed. Boxed alternatives may be shared
+/// with other values, so they are read only; use unshare to mutate them.
+template<typename T>
+using Access = std::conditional_t<details::holds_boxed<T, decltype(Value::data)>, T const, T>;
+
 /// Forward variant operations to variant member
 template<typename T>
 inline T const* get_if(Value const& v) { return get_if<T const>(v.data); }
 
 template<typename T>
-inline T* get_if(Value& v) { return get_if<T>(v.data); }
+inline Access<T>* get_if(Value& v) { return get_if<T>(v.data); }
+
+/// Alternative T of value prepared for mutation, copying it first when it is boxed and shared
+/// with other values. Returns nullptr when value holds other alternative.
+template<typename T>
+inline T* unshare(Value& v)
+{
+	if constexpr (details::holds_boxed<T, decltype(Value::data)>) {
+		if (auto box = std::get_if<Box<T>>(&v.data)) {
+			return box->unshare();
+		}
+		return nullptr;
+	} else {
+		return get_if<T>(v);
+	}
+}
 
 /// Returns type name of Value type
 std::string_view type_name(Value const& v);
@@ -118,7 +138,7 @@ Result<Value> wrap_value(Result<T> &&value)
 }
 
 template<typename Desired, typename V>
-constexpr Desired& get_ref(V &v)
+constexpr auto& get_ref(V &v)
 {
 	if constexpr (std::is_same_v<Desired, V>) {
 		return v;
@@ -145,9 +165,9 @@ concept With_Index_Operator = requires (Values &values, size_t i) {
 };
 
 template<typename ...T>
-constexpr auto match(With_Index_Operator auto& values) -> std::optional<std::tuple<T&...>>
+constexpr auto match(With_Index_Operator auto& values) -> std::optional<std::tuple<Access<T>&...>>
 {
-	return [&]<std::size_t ...I>(std::index_sequence<I...>) -> std::optional<std::tuple<T&...>> {
+	return [&]<std::size_t ...I>(std::index_sequence<I...>) -> std::optional<std::tuple<Access<T>&...>> {
 		if (sizeof...(T) == values.size() && (holds_alternative<T>(values[I]) && ...)) {
 			return {{ get_ref<T>(values[I])... }};
 		} else {
@@ -157,11 +177,11 @@ constexpr auto match(With_Index_Operator auto& values) -> std::optional<std::tup
 }
 
 template<typename ...T, typename ...Values>
-constexpr auto match(Values& ...values) -> std::optional<std::tuple<T&...>>
+constexpr auto match(Values& ...values) -> std::optional<std::tuple<Access<T>&...>>
 {
 	static_assert(sizeof...(T) == sizeof...(Values), "Provided parameters and expected types list must have the same length");
 
-	return [&]<std::size_t ...I>(std::index_sequence<I...>) -> std::optional<std::tuple<T&...>> {
+	return [&]<std::size_t ...I>(std::index_sequence<I...>) -> std::optional<std::tuple<Access<T>&...>> {
 		if ((holds_alternative<T>(values) && ...)) {
 			return {{ get_ref<T>(values)... }};
 		} else {
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+import argparse
+import dataclasses
+import os
+import platform
+import statistics
+import subprocess
+import time
+
+SYSTEM_TO_DIRECTORY = {
+    "Darwin": "macos",
+    "Linux": "linux",
+}
+
+system = platform.system()
+assert system in SYSTEM_TO_DIRECTORY.keys(), "platform is not supported yet"
+INTERPRETER = "bin/{system}/musique".format(**{
+    "system": SYSTEM_TO_DIRECTORY[system]
+})
+
+@dataclasses.dataclass
+class Benchmark:
+    name:      str
+    arguments: list[str]
+
+    def run(self, interpreter: list[str], cwd: str) -> float:
+        start = time.perf_counter()
+        subprocess.run(
+            args=[*interpreter, *self.arguments, "--dont-automatically-connect"],
+            stdout=subprocess.DEVNULL,
+            stderr=subprocess.DEVNULL,
+            cwd=cwd,
+            check=True,
+        )
+        return time.perf_counter() - start
+
+    def measure(self, interpreters: list[list[str]], cwd: str, repeat: int) -> list[float]:
+        # Runs of compared interpreters are interleaved, so changing load of the machine affects all of them
+        times = [list[float]() for _ in interpreters]
+        for _ in range(repeat):
+            for interpreter, measured in zip(interpreters, times):
+                measured.append(self.run(interpreter, cwd))
+        return [statistics.median(measured) for measured in times]
+
+BENCHMARKS = [
+    Benchmark("fib",          ["run", "examples/fib.mq", "code", "say (fib 22)"]),
+    Benchmark("permutations", ["run", "examples/permutations.mq", "code", "list_all_permutations (1 + up 7)"]),
+    Benchmark("while",        ["code", "i := 0, while (i < 50000) (i += 1)"]),
+    Benchmark("for",          ["code", "x := 0, for (up 50000) (i | x += i)"]),
+    Benchmark("symbols",      ["code", "n := 0, for (up 50000) (i | if ('foo == 'foo) (n += 1) nil)"]),
+    Benchmark("locals",       ["code", "count := (n | i := 0, while (i < n) (i += 1), i), count 50000"]),
+    Benchmark("arrays",       ["code", "xs := up 1000, n := 0, for (up 20000) (i | n += len xs)"]),
+    Benchmark("integers",     ["code", "n := 0, for (nprimes 20000) (i | n += (i % 12)), for (range 0 200000 3) (i | n = (n * 3 - i) % 1000), for (up 20000) (i | n += len (digits (i * 1234567)))"]),
+    Benchmark("fractions",    ["code", "total := 0, for (up 50000) (i | total = total + 1/12 + 3/32 + 7/48), total < 0"]),
+    Benchmark("vectorized",   ["code", "xs := up 1000, n := 0, for (up 2000) (i | n += len (((xs + i) * 3 - 1) % 7 < 3))"]),
+    Benchmark("music",        ["code", "melody := c4 + up 5000, for (up 400) (i | melody = set_oct 4 (set_len (1/8) (melody + 1))), len melody"]),
+    Benchmark("tail calls",   ["code", "count := (n acc | if (n <= 0) acc (count (n - 1) (acc + 1))), for (up 50) (i | count 1000 0)"]),
+]
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Benchmark runner for Musique programming language")
+    parser.add_argument("-i", "--interpreter", help="Interpreter that will be measured", default=INTERPRETER)
+    parser.add_argument("-b", "--baseline", help="Interpreter that measured one will be compared with")
+    parser.add_argument("-r", "--repeat", type=int, help="How many times each benchmark is run", default=5)
+    parser.add_argument("-f", "--filter", action="append", help="Run only benchmarks with given name", default=[])
+
+    args = parser.parse_args()
+
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+    if not os.path.exists(os.path.join(root, args.interpreter)):
+        subprocess.run("make", shell=True, check=True, cwd=root)
+
+    for benchmark in BENCHMARKS:
+        if args.filter and benchmark.name not in args.filter:
+            continue
+
+        interpreters = [[os.path.join(root, args.interpreter)]]
+        if args.baseline is not None:
+            interpreters.append([os.path.join(root, args.baseline)])
+
+        current, *baseline = benchmark.measure(interpreters, root, args.repeat)
+        if not baseline:
+            print(f"{benchmark.name:<16} {current:8.3f} secs")
+            continue
+
+        baseline = baseline[0]
+        print(f"{benchmark.name:<16} {current:8.3f} secs (baseline {baseline:8.3f} secs, {baseline / current:5.2f}x)")
@@ -5,6 +5,7 @@ import json
 import os
 import platform
 import subprocess
+import tempfile
 
 TEST_DIR = "regression-tests"
 TEST_DB = "test_db.json"
@@ -21,6 +22,17 @@ INTERPRETER = "bin/{system}/debug/musique".format(**{
     "system": SYSTEM_TO_DIRECTORY[system]
 })
 
+# Cases of this suite are rendered with --render instead of played with --timeline,
+# and bytes of MIDI file they wrote are recorded after their standard output
+RENDER_SUITE = "render"
+
+def midi_lines(path: str) -> list[str]:
+    if not os.path.isfile(path):
+        return ["no MIDI file was written"]
+    with open(path, "rb") as f:
+        data = f.read()
+    return [f"midi {data[i:i+16].hex(' ')}" for i in range(0, len(data), 16)]
+
 @dataclasses.dataclass
 class Result:
     exit_code:    int       = 0
@@ -36,22 +48,24 @@ class TestCase:
     stdout_lines: list[str] = dataclasses.field(default_factory=list)
     stderr_lines: list[str] = dataclasses.field(default_factory=list)
 
-    def run(self, interpreter: str, source: str, cwd: str):
-        result = subprocess.run(
-            args=[interpreter, "run", source, "--dont-automatically-connect"],
-            capture_output=True,
-            cwd=cwd,
-            text=True
-        )
-        return Result(
-            exit_code=result.returncode,
-            stdout_lines=result.stdout.splitlines(keepends=False),
-            stderr_lines=result.stderr.splitlines(keepends=False)
-        )
-
-    def record(self, interpreter: str, source: str, cwd: str):
+    def run(self, interpreter: str, source: str, cwd: str, render: bool):
+        with tempfile.TemporaryDirectory() as directory:
+            output = os.path.join(directory, "output.mid")
+            result = subprocess.run(
+                args=[interpreter, "run", source, *(["--render", output] if render else ["--timeline"])],
+                capture_output=True,
+                cwd=cwd,
+                text=True
+            )
+            return Result(
+                exit_code=result.returncode,
+                stdout_lines=result.stdout.splitlines(keepends=False) + (midi_lines(output) if render else []),
+                stderr_lines=result.stderr.splitlines(keepends=False)
+            )
+
+    def record(self, interpreter: str, source: str, cwd: str, render: bool):
         print(f"Recording case {self.name}")
-        result = self.run(interpreter, source, cwd)
+        result = self.run(interpreter, source, cwd, render)
 
         changes = []
         if self.exit_code    != result.exit_code:    changes.append("exit code")
@@ -62,9 +76,9 @@ class TestCase:
 
         self.exit_code, self.stderr_lines, self.stdout_lines = result.exit_code, result.stderr_lines, result.stdout_lines
 
-    def test(self, interpreter: str, source: str, cwd: str):
+    def test(self, interpreter: str, source: str, cwd: str, render: bool):
         print(f"  Testing case {self.name}  ", end="")
-        result = self.run(interpreter, source, cwd)
+        result = self.run(interpreter, source, cwd, render)
         if self.exit_code == result.exit_code and self.stdout_lines == result.stdout_lines and self.stderr_lines == result.stderr_lines:
             print("ok")
             return True
@@ -182,6 +196,34 @@ def traverse(discover: bool, update: bool) -> list[tuple[TestSuite, TestCase]]:
 
     return to_record
 
+def test_parallel_render(suite: TestSuite) -> bool:
+    """Render all cases of suite with one command, so each file is written by its own worker process"""
+    print(f"  Testing rendering of all cases at once  ", end="")
+    with tempfile.TemporaryDirectory() as directory:
+        sources = [argument for case in suite.cases for argument in ("run", os.path.join(TEST_DIR, suite.name, case.name))]
+        result = subprocess.run(
+            args=[os.path.join(root, INTERPRETER), *sources, "--render", directory],
+            capture_output=True,
+            cwd=root,
+            text=True
+        )
+        different = [
+            case.name for case in suite.cases
+            if midi_lines(os.path.join(directory, os.path.splitext(case.name)[0] + ".mid")) != [line for line in case.stdout_lines if line.startswith("midi ")]
+        ]
+
+    if result.returncode == 0 and not different:
+        print("ok")
+        return True
+
+    print("FAILED")
+    if result.returncode != 0:
+        print(f"Exit code {result.returncode}, standard error:")
+        print(result.stderr)
+    for name in different:
+        print(f"MIDI file of {name} differs from one rendered alone")
+    return False
+
 def test():
     successful, total = 0, 0
     for suite in suites:
@@ -189,11 +231,17 @@ def test():
         for case in suite.cases:
             successful += int(case.test(
                 interpreter=os.path.join(root, INTERPRETER),
-                source=os.path.join(testing_dir, suite.name, case.name),
-                cwd=root
+                # Relative to cwd, so locations in error messages don't depend on where repository is
+                source=os.path.join(TEST_DIR, suite.name, case.name),
+                cwd=root,
+                render=suite.name == RENDER_SUITE
             ))
             total += 1
 
+        if suite.name == RENDER_SUITE:
+            successful += int(test_parallel_render(suite))
+            total += 1
+
     print(f"Passed {successful} out of {total} ({100 * successful // total}%)")
     exit(1 if successful != total else 0)
 
@@ -234,8 +282,9 @@ if __name__ == "__main__":
     for (suite, case) in to_record:
         case.record(
             interpreter=os.path.join(root, INTERPRETER),
-            source=os.path.join(testing_dir, suite.name, case.name),
-            cwd=root
+            source=os.path.join(TEST_DIR, suite.name, case.name),
+            cwd=root,
+            render=suite.name == RENDER_SUITE
         )
 
     if to_record: